@@ -0,0 +1,104 @@
+// Measure the decoding of terminal escape sequences, on a stream of known
+// sequences and on random bytes
+//
+// Usage: key_decoder_bench [sequence_count]
+
+#include <ted/key_decoder.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::string_view sample_sequences[] {
+    "\e[A",   "\e[B",    "\e[C",     "\e[D",     "\eOA",   "\eOH",
+    "\e[H",   "\e[F",    "\e[1;5A",  "\e[1;2D",  "\e[1;3C", "\e[5~",
+    "\e[6~",  "\e[3~",   "\e[3;5~",  "\e[2~",    "\eOP",   "\e[15~",
+    "\e[24~", "\e[24;2~", "\e[1;5P", "\e[Z",     "\e[[A",  "\e[200~",
+};
+
+std::string generate_sequences(size_t count)
+{
+    std::mt19937_64 rng(42);
+    std::string input;
+    for (size_t index = 0; index < count; index++) {
+        input.append(sample_sequences[rng() % std::size(sample_sequences)]);
+    }
+    return input;
+}
+
+std::string generate_random_bytes(size_t size)
+{
+    std::mt19937_64 rng(42);
+    std::string input(size, '\0');
+    for (char& c : input) {
+        // One byte in four is an escape byte
+        c = rng() % 4 == 0 ? '\e' : static_cast<char>(rng() % 256);
+    }
+    return input;
+}
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+// Decode all the sequences of the input, skipping the bytes starting none
+void run(const char* name, std::string_view input)
+{
+    size_t sequence_count = 0;
+    size_t checksum = 0;
+    auto start = Clock::now();
+    ted::key_decoder::Decoder decoder;
+    while (!input.empty()) {
+        ted::key_decoder::Result result
+            = ted::key_decoder::decode(decoder, input);
+        if (result.status == ted::key_decoder::Status::Complete) {
+            sequence_count++;
+            checksum += result.key;
+        }
+        input.remove_prefix(result.length);
+    }
+    double decode_ms = elapsed_ms(start);
+    double sequence_ns = decode_ms * 1e6
+        / static_cast<double>(std::max<size_t>(sequence_count, 1));
+
+    std::printf(
+        "%-14s %12.1f %12zu %12.2f %12zu\n",
+        name,
+        decode_ms,
+        sequence_count,
+        sequence_ns,
+        checksum);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t sequence_count = 10'000'000;
+    if (argc > 1) {
+        sequence_count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::string sequences = generate_sequences(sequence_count);
+    std::string random_bytes = generate_random_bytes(sequences.size());
+
+    std::printf("%zu bytes per input\n", sequences.size());
+    std::printf(
+        "%-14s %12s %12s %12s %12s\n",
+        "input",
+        "decode (ms)",
+        "sequences",
+        "ns/sequence",
+        "checksum");
+    run("sequences", sequences);
+    run("random bytes", random_bytes);
+}
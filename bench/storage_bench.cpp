@@ -0,0 +1,175 @@
+// Compare the text storage backends of ted against the original
+// vector-of-strings layout of editor::File
+//
+// Usage: storage_bench [line_count]
+
+#include <ted/piece_table.hpp>
+#include <ted/rope.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t lookup_count = 1'000'000;
+constexpr size_t edit_count = 2'000;
+
+struct Lines {
+    std::vector<std::string> lines;
+};
+
+// Split the text as the other storages do: each newline ends a line, and the
+// text after the last one is a line as well, even if empty
+void init(Lines& storage, const std::string& text)
+{
+    size_t start = 0;
+    for (size_t end = text.find('\n'); end != std::string::npos;
+         end = text.find('\n', start)) {
+        storage.lines.emplace_back(text, start, end - start);
+        start = end + 1;
+    }
+    storage.lines.emplace_back(text, start);
+}
+
+size_t line_count(const Lines& storage)
+{
+    return storage.lines.size();
+}
+
+size_t line_length(const Lines& storage, size_t row)
+{
+    return storage.lines[row].size();
+}
+
+// Insert a newline in the middle of a line, splitting it in two
+void split_line(Lines& storage, size_t row)
+{
+    std::string& line = storage.lines[row];
+    std::string tail = line.substr(line.size() / 2);
+    line.resize(line.size() / 2);
+    storage.lines.insert(
+        storage.lines.begin() + static_cast<std::ptrdiff_t>(row) + 1,
+        std::move(tail));
+}
+
+template<class Storage>
+void split_line(Storage& storage, size_t row)
+{
+    size_t offset = line_start(storage, row) + line_length(storage, row) / 2;
+    insert(storage, offset, "\n");
+}
+
+std::string generate_text(size_t line_count)
+{
+    std::mt19937_64 rng(42);
+    std::string text;
+    text.reserve(line_count * 48);
+    for (size_t row = 0; row < line_count; row++) {
+        size_t length = 8 + (rng() % 80);
+        for (size_t col = 0; col < length; col++) {
+            text.push_back(static_cast<char>('a' + (rng() % 26)));
+        }
+        text.push_back('\n');
+    }
+    return text;
+}
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+// Random numbers picking the rows looked up and split, the same for every
+// storage so that their checksums can be compared
+struct Rows {
+    std::vector<size_t> lookups;
+    std::vector<size_t> edits;
+};
+
+Rows generate_rows()
+{
+    std::mt19937_64 rng(1);
+    Rows rows;
+    rows.lookups.resize(lookup_count);
+    for (size_t& row : rows.lookups) {
+        row = rng();
+    }
+    rows.edits.resize(edit_count);
+    for (size_t& row : rows.edits) {
+        row = rng();
+    }
+    return rows;
+}
+
+// Return the checksum of the lines looked up
+template<class Storage>
+size_t run(const char* name, const std::string& text, const Rows& rows)
+{
+    Storage storage;
+
+    auto start = Clock::now();
+    init(storage, text);
+    double load_ms = elapsed_ms(start);
+
+    size_t checksum = 0;
+    start = Clock::now();
+    for (size_t row : rows.lookups) {
+        checksum += line_length(storage, row % line_count(storage));
+    }
+    double lookup_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    for (size_t row : rows.edits) {
+        split_line(storage, row % line_count(storage));
+    }
+    double edit_ms = elapsed_ms(start);
+
+    std::printf(
+        "%-14s %12.1f %12.1f %12.1f %12zu\n",
+        name,
+        load_ms,
+        lookup_ms,
+        edit_ms,
+        checksum);
+    return checksum;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t line_count = 1'000'000;
+    if (argc > 1) {
+        line_count = std::strtoull(argv[1], nullptr, 10);
+    }
+    std::string text = generate_text(line_count);
+
+    std::printf(
+        "%zu lines, %zu bytes, %zu lookups, %zu line splits\n",
+        line_count,
+        text.size(),
+        lookup_count,
+        edit_count);
+    std::printf(
+        "%-14s %12s %12s %12s %12s\n",
+        "storage",
+        "load (ms)",
+        "lookup (ms)",
+        "edit (ms)",
+        "checksum");
+    Rows rows = generate_rows();
+    size_t checksum = run<Lines>("vector<string>", text, rows);
+    if (run<ted::piece_table::PieceTable>("piece table", text, rows) != checksum
+        || run<ted::rope::Rope>("rope", text, rows) != checksum) {
+        std::fputs("checksums differ, the storages hold other lines\n", stderr);
+        return EXIT_FAILURE;
+    }
+}
@@ -5,12 +5,20 @@
 #include <ted/tui.hpp>
 
 #include <cctype>
+#include <charconv>
 #include <cstdio>
+#include <optional>
 #include <span>
+#include <system_error>
 
 struct Arguments {
     std::vector<std::string> files;
     bool debug;
+    bool intern;
+    bool kitty_keyboard;
+    unsigned max_fps;
+    bool rope;
+    std::optional<size_t> undo_limit_mib;
 };
 
 static void usage()
@@ -21,6 +29,13 @@ static void usage()
 Options:
     --debug, -d     Enable debug information printing into stderr
     --help, -h      Print this help message
+    --intern        Keep each distinct line of files once, to save memory on
+                    repetitive files. Not available with --rope.
+    --kitty-keyboard
+                    Use the kitty keyboard protocol if the terminal supports it
+    --max-fps=N     Draw at most N frames per second
+    --rope          Store files in a rope instead of a piece table
+    --undo-limit=N  Keep at most N MiB of undo history per file
     --version, -v   Print version information
     --              All arguments after this will be interpreted as files to open
 )";
@@ -33,6 +48,21 @@ static void version()
     (void)std::fputs("Ted v" TED_VERSION "\n", stderr);
 }
 
+// Parse the value of an option "--name=N", exit on invalid values
+template<class T>
+static T parse_number_option(std::string_view arg)
+{
+    std::string_view value = arg.substr(arg.find('=') + 1);
+    T number {};
+    auto [end, error]
+        = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc {} || end != value.data() + value.size()) {
+        usage();
+        std::exit(EXIT_FAILURE);
+    }
+    return number;
+}
+
 static Arguments parse_arguments(std::span<char*> args)
 {
     Arguments arguments {};
@@ -43,6 +73,16 @@ static Arguments parse_arguments(std::span<char*> args)
                 swallow_remaining_as_files = true;
             } else if (arg == "-d" || arg == "--debug") {
                 arguments.debug = true;
+            } else if (arg == "--intern") {
+                arguments.intern = true;
+            } else if (arg == "--kitty-keyboard") {
+                arguments.kitty_keyboard = true;
+            } else if (arg.starts_with("--max-fps=")) {
+                arguments.max_fps = parse_number_option<unsigned>(arg);
+            } else if (arg == "--rope") {
+                arguments.rope = true;
+            } else if (arg.starts_with("--undo-limit=")) {
+                arguments.undo_limit_mib = parse_number_option<size_t>(arg);
             } else if (arg == "-h" || arg == "--help") {
                 usage();
                 std::exit(EXIT_SUCCESS);
@@ -63,9 +103,14 @@ static Arguments parse_arguments(std::span<char*> args)
 int main(int argc, char* argv[])
 {
     Arguments args = parse_arguments(std::span(argv, argc));
+    if (args.intern && args.rope) {
+        usage();
+        return EXIT_FAILURE;
+    }
 
     if (args.debug) {
         ted::os::print_source_location_at_exit(true);
+        ted::os::enable_debug_log(true);
     }
 
     if (!ted::os::isatty(stdin) || !ted::os::isatty(stdout)) {
@@ -74,13 +119,20 @@ int main(int argc, char* argv[])
     }
 
     ted::editor::init();
+    if (args.rope) {
+        ted::editor::state.storage = ted::editor::Storage::Rope;
+    }
+    ted::editor::state.intern_lines = args.intern;
+    ted::editor::state.max_fps = args.max_fps;
+    ted::editor::state.kitty_keyboard = args.kitty_keyboard;
+    if (args.undo_limit_mib) {
+        ted::editor::state.undo_limit = *args.undo_limit_mib * 1024 * 1024;
+    }
     ted::tui::init();
     if (args.files.size() == 0) {
         ted::editor::open_new_file();
     } else {
-        for (const auto& filepath : args.files) {
-            ted::editor::open_file(filepath.c_str());
-        }
+        ted::editor::open_files(args.files);
     }
     ted::tui::start();
 }
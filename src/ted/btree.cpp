@@ -0,0 +1,171 @@
+#include <ted/btree.hpp>
+
+namespace ted::btree {
+
+Summary summarize(const Branch* branch)
+{
+    Summary summary {};
+    for (size_t index = 0; index < branch->child_count; index++) {
+        summary.bytes += branch->summaries[index].bytes;
+        summary.newlines += branch->summaries[index].newlines;
+    }
+    return summary;
+}
+
+Branch* new_branch(std::pmr::memory_resource* resource)
+{
+    auto* branch
+        = new (resource->allocate(sizeof(Branch), alignof(Branch))) Branch;
+    branch->is_leaf = false;
+    branch->ref_count = 1;
+    branch->child_count = 0;
+    return branch;
+}
+
+Branch* copy_branch(std::pmr::memory_resource* resource, const Branch* branch)
+{
+    Branch* copy = new_branch(resource);
+    copy->child_count = branch->child_count;
+    std::copy_n(branch->summaries, branch->child_count, copy->summaries);
+    for (size_t index = 0; index < branch->child_count; index++) {
+        copy->children[index] = share(branch->children[index]);
+    }
+    return copy;
+}
+
+Node* share(Node* node)
+{
+    node->ref_count++;
+    return node;
+}
+
+Branch* insert_child(
+    std::pmr::memory_resource* resource,
+    Branch* branch,
+    size_t position,
+    Node* child,
+    const Summary& child_summary)
+{
+    Branch* target = branch;
+    Branch* sibling = nullptr;
+    if (branch->child_count == branch_capacity) {
+        sibling = new_branch(resource);
+        size_t half = branch_capacity / 2;
+        sibling->child_count = branch_capacity - half;
+        std::copy_n(
+            branch->children + half,
+            sibling->child_count,
+            sibling->children);
+        std::copy_n(
+            branch->summaries + half,
+            sibling->child_count,
+            sibling->summaries);
+        branch->child_count = half;
+        if (position > half) {
+            target = sibling;
+            position -= half;
+        }
+    }
+    std::copy_backward(
+        target->children + position,
+        target->children + target->child_count,
+        target->children + target->child_count + 1);
+    std::copy_backward(
+        target->summaries + position,
+        target->summaries + target->child_count,
+        target->summaries + target->child_count + 1);
+    target->children[position] = child;
+    target->summaries[position] = child_summary;
+    target->child_count++;
+    return sibling;
+}
+
+void remove_child(Branch* branch, size_t index)
+{
+    std::copy(
+        branch->children + index + 1,
+        branch->children + branch->child_count,
+        branch->children + index);
+    std::copy(
+        branch->summaries + index + 1,
+        branch->summaries + branch->child_count,
+        branch->summaries + index);
+    branch->child_count--;
+}
+
+void grow_root(
+    std::pmr::memory_resource* resource,
+    Node*& root,
+    Summary& summary,
+    Node* split,
+    const Summary& split_summary)
+{
+    Branch* branch = new_branch(resource);
+    branch->children[0] = root;
+    branch->summaries[0] = summary;
+    branch->children[1] = split;
+    branch->summaries[1] = split_summary;
+    branch->child_count = 2;
+    root = branch;
+    summary = summarize(branch);
+}
+
+Node* build(
+    std::pmr::memory_resource* resource,
+    std::vector<std::pair<Node*, Summary>> leaves,
+    Summary& summary)
+{
+    // Build the tree bottom-up from completely filled branches
+    std::vector<std::pair<Node*, Summary>> level = std::move(leaves);
+    while (level.size() > 1) {
+        std::vector<std::pair<Node*, Summary>> parents;
+        parents.reserve(level.size() / branch_capacity + 1);
+        for (size_t index = 0; index < level.size(); index++) {
+            if (index % branch_capacity == 0) {
+                parents.emplace_back(new_branch(resource), Summary {});
+            }
+            auto* parent = static_cast<Branch*>(parents.back().first);
+            parent->children[parent->child_count] = level[index].first;
+            parent->summaries[parent->child_count] = level[index].second;
+            parent->child_count++;
+        }
+        for (auto& [parent, parent_summary] : parents) {
+            parent_summary = summarize(static_cast<Branch*>(parent));
+        }
+        level = std::move(parents);
+    }
+    summary = level.front().second;
+    return level.front().first;
+}
+
+const Node* find_newline(const Node* node, size_t& newline, size_t& offset)
+{
+    while (!node->is_leaf) {
+        const auto* branch = static_cast<const Branch*>(node);
+        size_t index = 0;
+        while (newline > branch->summaries[index].newlines) {
+            newline -= branch->summaries[index].newlines;
+            offset += branch->summaries[index].bytes;
+            index++;
+        }
+        node = branch->children[index];
+    }
+    return node;
+}
+
+const Node* find_offset(const Node* node, size_t offset, size_t& leaf_offset)
+{
+    leaf_offset = 0;
+    while (!node->is_leaf) {
+        const auto* branch = static_cast<const Branch*>(node);
+        size_t index = 0;
+        while (offset >= leaf_offset + branch->summaries[index].bytes) {
+            leaf_offset += branch->summaries[index].bytes;
+            index++;
+        }
+        node = branch->children[index];
+    }
+    return node;
+}
+
+} // namespace ted::btree
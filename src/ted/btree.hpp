@@ -0,0 +1,539 @@
+#ifndef TED_BTREE_HPP_
+#define TED_BTREE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// B-tree shared by the text storages. Its leaves hold arrays of items, such as
+// characters or pieces, and its branches cache the byte and newline counts of
+// their subtrees. All leaves are at the same depth, so looking up a line or an
+// offset, inserting and erasing are O(log n) wherever they happen.
+// A storage describes its leaves with a `Traits` type providing:
+// - `Item`, the trivially copyable type of the items held by the leaves,
+// - `leaf_capacity`, the maximum number of items of a leaf,
+// - `summarize(std::span<const Item>)`, the counts of a span of items.
+namespace ted::btree {
+
+// Maximum number of children of a branch
+inline constexpr size_t branch_capacity = 16;
+
+struct Summary {
+    size_t bytes;
+    size_t newlines;
+};
+
+// Nodes referenced more than once are shared with a snapshot, and copied
+// before being modified
+struct Node {
+    bool is_leaf;
+    uint32_t ref_count;
+};
+
+template<class Traits>
+struct Leaf : Node {
+    static_assert(std::is_trivially_copyable_v<typename Traits::Item>);
+
+    size_t count;
+    typename Traits::Item items[Traits::leaf_capacity];
+};
+
+// Branches cache the counts of each of their subtrees next to the child
+// pointers, so that offset and line lookups only descend a single path from
+// the root without touching the sibling nodes
+struct Branch : Node {
+    size_t child_count;
+    Summary summaries[branch_capacity];
+    Node* children[branch_capacity];
+};
+
+// Root of a tree, with the counts of the whole tree. The nodes are allocated
+// from `resource`, which must outlive the tree.
+template<class Traits>
+struct Tree {
+    Node* root = nullptr;
+    Summary summary {};
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+    Tree() = default;
+    explicit Tree(std::pmr::memory_resource* resource);
+    Tree(const Tree&) = delete;
+    Tree(Tree&& other) noexcept;
+    Tree& operator=(const Tree&) = delete;
+    Tree& operator=(Tree&& other) noexcept;
+    ~Tree();
+};
+
+[[nodiscard]]
+Summary summarize(const Branch* branch);
+
+[[nodiscard]]
+Branch* new_branch(std::pmr::memory_resource* resource);
+
+// Copy of a branch sharing the children of the original
+[[nodiscard]]
+Branch* copy_branch(std::pmr::memory_resource* resource, const Branch* branch);
+
+Node* share(Node* node);
+
+// Insert a child at `position` in a branch, splitting the branch in two halves
+// if it is full. Return the new right sibling of the branch, if split.
+Branch* insert_child(
+    std::pmr::memory_resource* resource,
+    Branch* branch,
+    size_t position,
+    Node* child,
+    const Summary& child_summary);
+
+void remove_child(Branch* branch, size_t index);
+
+// Replace `root` by a new root whose children are the old root and its new
+// right sibling `split`
+void grow_root(
+    std::pmr::memory_resource* resource,
+    Node*& root,
+    Summary& summary,
+    Node* split,
+    const Summary& split_summary);
+
+// Build the upper levels of a tree over leaves holding the whole text, in
+// order, and return its root. `leaves` must not be empty.
+[[nodiscard]]
+Node* build(
+    std::pmr::memory_resource* resource,
+    std::vector<std::pair<Node*, Summary>> leaves,
+    Summary& summary);
+
+// Descend from `node` to the leaf holding the `newline`-th newline of its
+// subtree, counting from 1. `newline` is made relative to the leaf, and
+// `offset` is advanced by the offset of the leaf in the subtree.
+[[nodiscard]]
+const Node* find_newline(const Node* node, size_t& newline, size_t& offset);
+
+// Descend from `node` to the leaf containing `offset`, which must be within its
+// subtree. `leaf_offset` is set to the offset of the leaf in the subtree.
+[[nodiscard]]
+const Node* find_offset(const Node* node, size_t offset, size_t& leaf_offset);
+
+template<class Traits>
+[[nodiscard]]
+Summary summarize(const Leaf<Traits>& leaf)
+{
+    return Traits::summarize(
+        std::span<const typename Traits::Item>(leaf.items, leaf.count));
+}
+
+// Nodes are trivially destructible, so they are simply created in and given
+// back to the memory resource of their tree
+template<class Traits>
+[[nodiscard]]
+Leaf<Traits>* new_leaf(
+    std::pmr::memory_resource* resource,
+    std::span<const typename Traits::Item> items = {})
+{
+    auto* leaf = new (resource->allocate(
+        sizeof(Leaf<Traits>),
+        alignof(Leaf<Traits>))) Leaf<Traits>;
+    leaf->is_leaf = true;
+    leaf->ref_count = 1;
+    leaf->count = items.size();
+    if (!items.empty()) {
+        std::memcpy(leaf->items, items.data(), items.size_bytes());
+    }
+    return leaf;
+}
+
+// Give `node` its own copy of the node it references if the node is shared,
+// before modifying it
+template<class Traits>
+void make_unique(std::pmr::memory_resource* resource, Node*& node)
+{
+    if (node->ref_count == 1) {
+        return;
+    }
+    node->ref_count--;
+    if (node->is_leaf) {
+        const auto* leaf = static_cast<const Leaf<Traits>*>(node);
+        node = new_leaf<Traits>(
+            resource,
+            std::span<const typename Traits::Item>(leaf->items, leaf->count));
+        return;
+    }
+    node = copy_branch(resource, static_cast<const Branch*>(node));
+}
+
+template<class Traits>
+void destroy(std::pmr::memory_resource* resource, Node* node)
+{
+    if (node == nullptr || --node->ref_count > 0) {
+        return;
+    }
+    if (node->is_leaf) {
+        resource->deallocate(
+            node,
+            sizeof(Leaf<Traits>),
+            alignof(Leaf<Traits>));
+        return;
+    }
+    auto* branch = static_cast<Branch*>(node);
+    for (size_t index = 0; index < branch->child_count; index++) {
+        destroy<Traits>(resource, branch->children[index]);
+    }
+    resource->deallocate(branch, sizeof(Branch), alignof(Branch));
+}
+
+template<class Traits>
+Tree<Traits>::Tree(std::pmr::memory_resource* resource)
+    : resource(resource)
+{
+}
+
+template<class Traits>
+Tree<Traits>::Tree(Tree&& other) noexcept
+    : root(std::exchange(other.root, nullptr))
+    , summary(std::exchange(other.summary, {}))
+    , resource(other.resource)
+{
+}
+
+template<class Traits>
+Tree<Traits>& Tree<Traits>::operator=(Tree&& other) noexcept
+{
+    if (this != &other) {
+        destroy<Traits>(resource, root);
+        root = std::exchange(other.root, nullptr);
+        summary = std::exchange(other.summary, {});
+        resource = other.resource;
+    }
+    return *this;
+}
+
+template<class Traits>
+Tree<Traits>::~Tree()
+{
+    destroy<Traits>(resource, root);
+}
+
+// Reset the tree to the given leaves, holding the whole text in order, or to a
+// single empty leaf if there are none
+template<class Traits>
+void assign(Tree<Traits>& tree, std::vector<std::pair<Node*, Summary>> leaves)
+{
+    destroy<Traits>(tree.resource, tree.root);
+    if (leaves.empty()) {
+        leaves.emplace_back(new_leaf<Traits>(tree.resource), Summary {});
+    }
+    tree.root = build(tree.resource, std::move(leaves), tree.summary);
+}
+
+// Reset the tree to hold a copy of the given items, in completely filled
+// leaves
+template<class Traits>
+void assign(Tree<Traits>& tree, std::span<const typename Traits::Item> items)
+{
+    std::vector<std::pair<Node*, Summary>> leaves;
+    leaves.reserve(items.size() / Traits::leaf_capacity + 1);
+    for (size_t start = 0; start < items.size();
+         start += Traits::leaf_capacity) {
+        auto chunk = items.subspan(
+            start,
+            std::min(Traits::leaf_capacity, items.size() - start));
+        leaves.emplace_back(
+            new_leaf<Traits>(tree.resource, chunk),
+            Traits::summarize(chunk));
+    }
+    assign(tree, std::move(leaves));
+}
+
+// Tree sharing the nodes of another one, taken in O(1). The snapshot can be
+// read from another thread while the tree is edited, as the edits copy the
+// shared nodes instead of modifying them, but must be destroyed by the thread
+// editing the tree.
+template<class Traits>
+[[nodiscard]]
+Tree<Traits> snapshot(const Tree<Traits>& tree)
+{
+    Tree<Traits> copy(tree.resource);
+    copy.root = share(tree.root);
+    copy.summary = tree.summary;
+    return copy;
+}
+
+// Forget the nodes of the tree without giving them back to its resource, for
+// when the resource is about to be released as a whole. The snapshots sharing
+// the nodes must be destroyed beforehand.
+template<class Traits>
+void release(Tree<Traits>& tree)
+{
+    tree.root = nullptr;
+    tree.summary = {};
+}
+
+// Insert items in a leaf at `index`, splitting the leaf in two halves if they
+// do not fit. At most `Traits::leaf_capacity` items can be inserted at once.
+// Return the new right sibling of the leaf, if split.
+template<class Traits>
+Leaf<Traits>* insert_items(
+    std::pmr::memory_resource* resource,
+    Leaf<Traits>& leaf,
+    size_t index,
+    std::span<const typename Traits::Item> items)
+{
+    size_t count = leaf.count + items.size();
+    if (count <= Traits::leaf_capacity) {
+        std::copy_backward(
+            leaf.items + index,
+            leaf.items + leaf.count,
+            leaf.items + count);
+        std::copy_n(items.data(), items.size(), leaf.items + index);
+        leaf.count = count;
+        return nullptr;
+    }
+    typename Traits::Item buffer[2 * Traits::leaf_capacity];
+    std::copy_n(leaf.items, index, buffer);
+    std::copy_n(items.data(), items.size(), buffer + index);
+    std::copy(
+        leaf.items + index,
+        leaf.items + leaf.count,
+        buffer + index + items.size());
+    size_t half = count / 2;
+    std::copy_n(buffer, half, leaf.items);
+    leaf.count = half;
+    return new_leaf<Traits>(
+        resource,
+        std::span<const typename Traits::Item>(buffer + half, count - half));
+}
+
+// Erase the items [start, end) of a leaf
+template<class Traits>
+void erase_items(Leaf<Traits>& leaf, size_t start, size_t end)
+{
+    std::copy(leaf.items + end, leaf.items + leaf.count, leaf.items + start);
+    leaf.count -= end - start;
+}
+
+// Insert at `offset` in the subtree of `node`, whose counts are updated in
+// `summary`, by calling `insert_in_leaf(leaf, offset)` with the leaf containing
+// the offset and the offset relative to it. The callback returns the new right
+// sibling of the leaf if it had to be split. If the node has to be split,
+// return its new right sibling and store the counts of the sibling in
+// `split_summary`, otherwise return nullptr.
+template<class Traits, class LeafInserter>
+Node* insert_in_node(
+    std::pmr::memory_resource* resource,
+    Node* node,
+    Summary& summary,
+    size_t offset,
+    LeafInserter& insert_in_leaf,
+    Summary& split_summary)
+{
+    if (node->is_leaf) {
+        auto& leaf = static_cast<Leaf<Traits>&>(*node);
+        Leaf<Traits>* split = insert_in_leaf(leaf, offset);
+        summary = summarize(leaf);
+        if (split != nullptr) {
+            split_summary = summarize(*split);
+        }
+        return split;
+    }
+
+    auto* branch = static_cast<Branch*>(node);
+    size_t index = 0;
+    while (index + 1 < branch->child_count
+           && offset > branch->summaries[index].bytes) {
+        offset -= branch->summaries[index].bytes;
+        index++;
+    }
+    make_unique<Traits>(resource, branch->children[index]);
+    Summary child_split_summary {};
+    Node* child_split = insert_in_node<Traits>(
+        resource,
+        branch->children[index],
+        branch->summaries[index],
+        offset,
+        insert_in_leaf,
+        child_split_summary);
+    Branch* sibling = nullptr;
+    if (child_split != nullptr) {
+        sibling = insert_child(
+            resource,
+            branch,
+            index + 1,
+            child_split,
+            child_split_summary);
+    }
+    summary = summarize(branch);
+    if (sibling != nullptr) {
+        split_summary = summarize(sibling);
+    }
+    return sibling;
+}
+
+// Insert at `offset`, which must be within the text, through
+// `insert_in_leaf(leaf, offset)` as described by insert_in_node()
+template<class Traits, class LeafInserter>
+void insert(Tree<Traits>& tree, size_t offset, LeafInserter&& insert_in_leaf)
+{
+    make_unique<Traits>(tree.resource, tree.root);
+    Summary split_summary {};
+    Node* split = insert_in_node<Traits>(
+        tree.resource,
+        tree.root,
+        tree.summary,
+        offset,
+        insert_in_leaf,
+        split_summary);
+    if (split != nullptr) {
+        grow_root(tree.resource, tree.root, tree.summary, split, split_summary);
+    }
+}
+
+// Merge the leaf children of a branch that fit together in a single leaf, so
+// that repeated erasures do not leave the tree full of tiny leaves
+template<class Traits>
+void merge_small_leaves(std::pmr::memory_resource* resource, Branch* branch)
+{
+    size_t index = 0;
+    while (index + 1 < branch->child_count) {
+        Node* left = branch->children[index];
+        Node* right = branch->children[index + 1];
+        if (!left->is_leaf || !right->is_leaf
+            || static_cast<Leaf<Traits>*>(left)->count
+                    + static_cast<Leaf<Traits>*>(right)->count
+                > Traits::leaf_capacity) {
+            index++;
+            continue;
+        }
+        make_unique<Traits>(resource, branch->children[index]);
+        auto* left_leaf = static_cast<Leaf<Traits>*>(branch->children[index]);
+        const auto* right_leaf = static_cast<const Leaf<Traits>*>(right);
+        std::copy_n(
+            right_leaf->items,
+            right_leaf->count,
+            left_leaf->items + left_leaf->count);
+        left_leaf->count += right_leaf->count;
+        Summary& left_summary = branch->summaries[index];
+        left_summary.bytes += branch->summaries[index + 1].bytes;
+        left_summary.newlines += branch->summaries[index + 1].newlines;
+        destroy<Traits>(resource, right);
+        remove_child(branch, index + 1);
+    }
+}
+
+// Erase the range [start, end) relative to the beginning of `node`, whose
+// counts are updated in `summary`, by calling `erase_in_leaf(leaf, start, end)`
+// with each leaf overlapping the range and the part of the range relative to
+// it
+template<class Traits, class LeafEraser>
+void erase_range(
+    std::pmr::memory_resource* resource,
+    Node* node,
+    Summary& summary,
+    size_t start,
+    size_t end,
+    LeafEraser& erase_in_leaf)
+{
+    if (node->is_leaf) {
+        auto& leaf = static_cast<Leaf<Traits>&>(*node);
+        erase_in_leaf(leaf, start, end);
+        summary = summarize(leaf);
+        return;
+    }
+
+    auto* branch = static_cast<Branch*>(node);
+    size_t child_start = 0;
+    size_t index = 0;
+    while (index < branch->child_count && child_start < end) {
+        Summary& child_summary = branch->summaries[index];
+        size_t child_end = child_start + child_summary.bytes;
+        if (child_end > start) {
+            make_unique<Traits>(resource, branch->children[index]);
+            erase_range<Traits>(
+                resource,
+                branch->children[index],
+                child_summary,
+                std::max(start, child_start) - child_start,
+                std::min(end, child_end) - child_start,
+                erase_in_leaf);
+        }
+        child_start = child_end;
+        if (child_summary.bytes == 0) {
+            destroy<Traits>(resource, branch->children[index]);
+            remove_child(branch, index);
+        } else {
+            index++;
+        }
+    }
+    merge_small_leaves<Traits>(resource, branch);
+    summary = summarize(branch);
+}
+
+// Erase the range [start, end), which must be within the text, through
+// `erase_in_leaf(leaf, start, end)` as described by erase_range()
+template<class Traits, class LeafEraser>
+void erase(
+    Tree<Traits>& tree,
+    size_t start,
+    size_t end,
+    LeafEraser&& erase_in_leaf)
+{
+    make_unique<Traits>(tree.resource, tree.root);
+    erase_range<Traits>(
+        tree.resource,
+        tree.root,
+        tree.summary,
+        start,
+        end,
+        erase_in_leaf);
+
+    // Shrink the tree while the root has a single child
+    while (!tree.root->is_leaf) {
+        auto* root = static_cast<Branch*>(tree.root);
+        if (root->child_count > 1) {
+            break;
+        }
+        tree.root = root->child_count == 1 ? root->children[0]
+                                           : new_leaf<Traits>(tree.resource);
+        root->child_count = 0;
+        destroy<Traits>(tree.resource, root);
+    }
+}
+
+// Call `visitor(leaf, start, end)` with each leaf overlapping the range
+// [start, end) relative to the beginning of `node`, in order, along with the
+// part of the range relative to the leaf
+template<class Traits, class Visitor>
+void for_each_leaf(const Node* node, size_t start, size_t end, Visitor& visitor)
+{
+    if (node->is_leaf) {
+        visitor(static_cast<const Leaf<Traits>&>(*node), start, end);
+        return;
+    }
+    const auto* branch = static_cast<const Branch*>(node);
+    size_t child_start = 0;
+    for (size_t index = 0; index < branch->child_count; index++) {
+        size_t child_end = child_start + branch->summaries[index].bytes;
+        if (child_start >= end) {
+            break;
+        }
+        if (child_end > start) {
+            for_each_leaf<Traits>(
+                branch->children[index],
+                std::max(start, child_start) - child_start,
+                std::min(end, child_end) - child_start,
+                visitor);
+        }
+        child_start = child_end;
+    }
+}
+
+} // namespace ted::btree
+
+#endif // TED_BTREE_HPP_
@@ -1,18 +1,144 @@
 #include <ted/editor.hpp>
+#include <ted/event_loop.hpp>
+#include <ted/line_intern.hpp>
 #include <ted/os.hpp>
 #include <ted/term.hpp>
 #include <ted/tui.hpp>
+#include <ted/undo.hpp>
+#include <ted/utils.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <format>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
 
 namespace ted::editor {
 
 State state;
 
+// Call `function` with the storage backend of a file, whose functions are
+// then found by argument-dependent lookup in piece_table:: or rope::
+template<class Function>
+static decltype(auto) visit_text(const File& file, Function&& function)
+{
+    return std::visit(std::forward<Function>(function), file.text);
+}
+
+template<class Function>
+static decltype(auto) visit_text(File& file, Function&& function)
+{
+    return std::visit(std::forward<Function>(function), file.text);
+}
+
+// Files larger than this are loaded progressively
+static constexpr size_t progressive_load_threshold = size_t { 8 } * 1024 * 1024;
+
+// The files opened in the background cannot look at the state, so the
+// settings they need are copied from it beforehand
+struct LoadOptions {
+    Storage storage;
+    bool intern_lines;
+    // Number of lines needed to draw a screen
+    size_t screen_rows;
+};
+
+static LoadOptions get_load_options()
+{
+    return LoadOptions {
+        .storage = state.storage,
+        .intern_lines = state.intern_lines,
+        .screen_rows = get_screen_rows(),
+    };
+}
+
+File::~File()
+{
+    // The nodes of the storage are freed at once with `memory` rather than
+    // one by one. The save jobs holding snapshots of the file are already
+    // destroyed.
+    visit_text(*this, [](auto& storage) { release(storage); });
+}
+
+// Free the text as loaded once nothing references it
+static void release_loaded_text(File& file)
+{
+    file.mapping = {};
+    file.loaded_text = {};
+}
+
+// Replace the loaded text by its distinct lines, from which the pieces of the
+// table assemble the text. The whole text is hashed before it is shown, so
+// interned files are never loaded progressively.
+static void init_interned(
+    File& file,
+    piece_table::PieceTable& table,
+    std::string_view content)
+{
+    line_intern::InternedText interned = line_intern::intern(content);
+    if (!content.empty()) {
+        os::debug_log_format(
+            "{}: {} lines, {} distinct, dedup ratio {:.2f}, {}/{} bytes kept",
+            file.path,
+            interned.line_count,
+            interned.distinct_line_count,
+            static_cast<double>(interned.line_count)
+                / static_cast<double>(interned.distinct_line_count),
+            interned.text.size(),
+            content.size());
+    }
+    release_loaded_text(file);
+    file.loaded_text = std::move(interned.text);
+    piece_table::init(
+        table,
+        std::string_view(file.loaded_text.data(), file.loaded_text.size()),
+        interned.pieces);
+}
+
+static void init_text(
+    File& file,
+    std::string_view content,
+    const LoadOptions& options)
+{
+    switch (options.storage) {
+    case Storage::PieceTable: {
+        auto& table = file.text.emplace<piece_table::PieceTable>(&file.memory);
+        if (options.intern_lines) {
+            init_interned(file, table, content);
+        } else if (content.size() >= progressive_load_threshold) {
+            // Index enough lines to draw the first screen right away
+            piece_table::init_progressive(table, content, options.screen_rows);
+        } else {
+            piece_table::init(table, content);
+        }
+        break;
+    }
+    case Storage::Rope:
+        // The rope holds its own copy of the text, the loaded one can be freed
+        rope::init(file.text.emplace<rope::Rope>(&file.memory), content);
+        release_loaded_text(file);
+        break;
+    }
+}
+
 void init()
 {
     // Load default configuration
     state.eob_char = '~';
+    state.tab_stop = 8;
+    state.storage = Storage::PieceTable;
+    state.max_fps = 0;
+    state.kitty_keyboard = false;
+    state.undo_limit = size_t { 64 } * 1024 * 1024;
     // Keymap is not initialized here as the default mapping could change
     // between a TUI or GUI mode
 }
@@ -30,6 +156,45 @@ void screen_buffer_append_n(const char* s, size_t n)
     state.screen_buffer.append(s, n);
 }
 
+// Ask the system to load the mapped text around the viewport ahead of drawing
+static void advise_viewport()
+{
+    // A closed file may be followed by another one at the same address, unlike
+    // its handle
+    static FileHandle advised_handle;
+    static size_t advised_row = 0;
+
+    const File& file = *state.viewed_file;
+    size_t viewport_row = state.viewport_offset.row;
+    if (file.mapping.size == 0
+        || (advised_handle == state.viewed_handle
+            && advised_row == viewport_row)) {
+        return;
+    }
+    advised_handle = state.viewed_handle;
+    advised_row = viewport_row;
+
+    // Cover one screen above and below the viewport
+    size_t rows = get_screen_rows();
+    size_t first_row = viewport_row - std::min(viewport_row, rows);
+    size_t last_row = viewport_row + (2 * rows);
+    visit_text(file, [&](const auto& text) {
+        size_t start = line_start(text, first_row);
+        size_t end = line_start(text, last_row);
+        for_each_span(text, start, end - start, [&](std::string_view span) {
+            // Only the unmodified spans lie in the mapping
+            const char* mapping_end = file.mapping.data + file.mapping.size;
+            if (file.mapping.data <= span.data() && span.data() < mapping_end) {
+                os::advise(
+                    file.mapping,
+                    span.data() - file.mapping.data,
+                    span.size(),
+                    os::Advice::WillNeed);
+            }
+        });
+    });
+}
+
 void scroll()
 {
     auto& viewport_row = editor::state.viewport_offset.row;
@@ -41,28 +206,63 @@ void scroll()
     if (editor::get_cursor_row() >= viewport_row + editor::get_screen_rows()) {
         viewport_row = editor::get_cursor_row() - editor::get_screen_rows() + 1;
     }
-    if (editor::get_cursor_col() < viewport_col) {
-        viewport_col = editor::get_cursor_col();
+    size_t cursor_col = editor::get_cursor_render_col();
+    if (cursor_col < viewport_col) {
+        viewport_col = cursor_col;
     }
-    if (editor::get_cursor_col() >= viewport_col + editor::get_screen_cols()) {
-        viewport_col = editor::get_cursor_col() - editor::get_screen_cols() + 1;
+    if (cursor_col >= viewport_col + editor::get_screen_cols()) {
+        viewport_col = cursor_col - editor::get_screen_cols() + 1;
     }
+
+    advise_viewport();
 }
 
-// TODO consider using std::optional
-static std::string* get_cursor_text_line()
+static size_t get_cursor_line_length()
 {
-    if (state.cursor_coord.row >= state.viewed_file->lines.size()) {
-        return nullptr;
+    if (!has_line(*state.viewed_file, state.cursor_coord.row)) {
+        return 0;
+    }
+    return line_length(*state.viewed_file, state.cursor_coord.row);
+}
+
+// Start of the character holding the byte `col` of the line `row`
+static size_t char_start(const File& file, size_t row, size_t col)
+{
+    if (col == 0 || !has_line(file, row) || col >= line_length(file, row)) {
+        return col;
+    }
+    size_t first = col - std::min(col, utils::max_char_length - 1);
+    std::string scratch;
+    std::string_view text
+        = line_text(file, row, first, col + 1 - first, scratch);
+    size_t index = text.size() - 1;
+    while (index > 0 && utils::is_continuation_byte(text[index])) {
+        index--;
     }
-    return &state.viewed_file->lines[state.cursor_coord.row];
+    return first + index;
+}
+
+// Length of the character starting at the byte `col` of the line `row`, the
+// newline ending the line taking one byte
+static size_t char_length(const File& file, size_t row, size_t col)
+{
+    std::string scratch;
+    std::string_view next
+        = line_text(file, row, col + 1, utils::max_char_length - 1, scratch);
+    size_t length = 1;
+    while (length <= next.size()
+           && utils::is_continuation_byte(next[length - 1])) {
+        length++;
+    }
+    return length;
 }
 
 static void fixup_cursor_col()
 {
-    auto* cursor_line = get_cursor_text_line();
-    size_t rowlen = cursor_line ? cursor_line->size() : 0;
-    state.cursor_coord.col = std::min(state.cursor_coord.col, rowlen);
+    Coord& cursor = state.cursor_coord;
+    cursor.col = std::min(cursor.col, get_cursor_line_length());
+    // Never within a character
+    cursor.col = char_start(*state.viewed_file, cursor.row, cursor.col);
 }
 
 void cursor_up()
@@ -74,23 +274,24 @@ void cursor_up()
 }
 void cursor_down()
 {
-    if (state.cursor_coord.row < state.viewed_file->lines.size() - 1) {
+    if (has_line(*state.viewed_file, state.cursor_coord.row + 1)) {
         state.cursor_coord.row++;
     }
     fixup_cursor_col();
 }
 void cursor_left()
 {
-    if (state.cursor_coord.col > 0) {
-        state.cursor_coord.col--;
+    Coord& cursor = state.cursor_coord;
+    if (cursor.col > 0) {
+        cursor.col = char_start(*state.viewed_file, cursor.row, cursor.col - 1);
     }
     fixup_cursor_col();
 }
 void cursor_right()
 {
-    auto* cursor_line = get_cursor_text_line();
-    if (cursor_line && state.cursor_coord.col < cursor_line->size()) {
-        state.cursor_coord.col++;
+    Coord& cursor = state.cursor_coord;
+    if (cursor.col < get_cursor_line_length()) {
+        cursor.col += char_length(*state.viewed_file, cursor.row, cursor.col);
     }
     fixup_cursor_col();
 }
@@ -128,7 +329,6 @@ size_t get_cursor_col()
 {
     return state.cursor_coord.col;
 }
-
 void set_screen_size(ScreenSize screen_size)
 {
     state.screen_size = screen_size;
@@ -155,6 +355,437 @@ size_t get_screen_cols()
     return state.screen_size.cols;
 }
 
+// Offset in the text of the viewed file of the character under the cursor
+static size_t get_cursor_offset()
+{
+    File& file = *state.viewed_file;
+    size_t row = state.cursor_coord.row;
+    std::optional<LineStart>& cached = file.cursor_line_start;
+    if (cached && cached->row == row) {
+        return cached->offset + state.cursor_coord.col;
+    }
+    // The start of a missing line moves with the end of the text, so it is
+    // not kept
+    cached.reset();
+    file.cursor_render_col.reset();
+    size_t start = visit_text(file, [&](const auto& text) {
+        size_t start = line_start(text, row);
+        if (has_line(text, row)) {
+            cached = LineStart { row, start };
+        }
+        return start;
+    });
+    return start + state.cursor_coord.col;
+}
+
+static size_t get_line_start(const File& file, size_t row)
+{
+    return visit_text(
+        file,
+        [row](const auto& text) { return line_start(text, row); });
+}
+
+// Whether the byte `col` of a line starts a column: the continuation bytes of a
+// character, or following a tab, take no column
+static bool starts_column(char c, size_t col)
+{
+    return col == 0 || !utils::is_continuation_byte(c);
+}
+
+static size_t column_width(char c, size_t render_col)
+{
+    return c == '\t' ? state.tab_stop - (render_col % state.tab_stop) : 1;
+}
+
+// Move a column of the line starting at `line_offset` forward, up to the byte
+// `end_col` or up to the character spanning the display column `render_col`,
+// whichever comes first
+static LineColumn advance_column(
+    const File& file,
+    size_t line_offset,
+    LineColumn column,
+    size_t end_col,
+    size_t render_col)
+{
+    bool found = false;
+    auto advance_span = [&](std::string_view span) {
+        for (char c : span) {
+            if (starts_column(c, column.col)) {
+                size_t width = column_width(c, column.render_col);
+                if (column.render_col + width > render_col) {
+                    found = true;
+                    return;
+                }
+                column.render_col += width;
+            }
+            column.col++;
+        }
+    };
+    visit_text(file, [&](const auto& text) {
+        for_each_span(
+            text,
+            line_offset + column.col,
+            end_col - column.col,
+            [&](std::string_view span) {
+                if (!found) {
+                    advance_span(span);
+                }
+            });
+    });
+    return column;
+}
+
+// Move a column of the line starting at `line_offset` backward, down to the
+// byte `col` or down to the display column `render_col`, whichever comes first.
+// The width of a tab depends on the text before it, so nothing is returned if
+// one is crossed.
+static std::optional<LineColumn> retreat_column(
+    const File& file,
+    size_t line_offset,
+    LineColumn column,
+    size_t col,
+    size_t render_col)
+{
+    std::string scratch;
+    std::string_view text
+        = text_range(file, line_offset + col, column.col - col, scratch);
+    size_t index = text.size();
+    while (index > 0 && column.render_col > render_col) {
+        index--;
+        char c = text[index];
+        if (c == '\t') {
+            return std::nullopt;
+        }
+        if (starts_column(c, col + index)) {
+            column = LineColumn { col + index, column.render_col - 1 };
+        }
+    }
+    if (column.col != col && column.render_col > render_col) {
+        return std::nullopt;
+    }
+    return column;
+}
+
+// Display column of the cursor when it is known in the line `row`
+static std::optional<LineColumn> cursor_column(const File& file, size_t row)
+{
+    if (!file.cursor_line_start || file.cursor_line_start->row != row) {
+        return std::nullopt;
+    }
+    return file.cursor_render_col;
+}
+
+size_t get_cursor_render_col()
+{
+    File& file = *state.viewed_file;
+    const Coord& cursor = state.cursor_coord;
+    if (!has_line(file, cursor.row)) {
+        return cursor.col;
+    }
+    // Keeps the start of the line of the cursor, which its column goes with
+    get_cursor_offset();
+    size_t col = std::min(cursor.col, line_length(file, cursor.row));
+    size_t cursor_render_col = render_col(file, cursor.row, col);
+    if (file.cursor_line_start) {
+        file.cursor_render_col = LineColumn { col, cursor_render_col };
+    }
+    // Past the end of the line
+    return cursor_render_col + (cursor.col - col);
+}
+
+// Row and column of an offset in the text of a file
+static Coord get_offset_coord(const File& file, size_t offset)
+{
+    return visit_text(file, [offset](const auto& text) {
+        // Look for the last line starting at or before the offset
+        size_t first = 0;
+        size_t last = line_count(text) - 1;
+        while (first < last) {
+            size_t middle = first + ((last - first + 1) / 2);
+            if (line_start(text, middle) <= offset) {
+                first = middle;
+            } else {
+                last = middle - 1;
+            }
+        }
+        return Coord { first, offset - line_start(text, first) };
+    });
+}
+
+// Called after editing the text of a file from `offset` onwards
+static void mark_edited(File& file, size_t offset)
+{
+    file.revision++;
+    // The lines starting at or before the edit have not moved, nor the
+    // columns of the line of the cursor before it
+    const std::optional<LineStart>& line = file.cursor_line_start;
+    const std::optional<LineColumn>& column = file.cursor_render_col;
+    if (line && offset < line->offset) {
+        file.cursor_line_start.reset();
+    }
+    if (!line || (column && offset < line->offset + column->col)) {
+        file.cursor_render_col.reset();
+    }
+}
+
+// Called before editing the text of a file from `offset` onwards. The display
+// column of the cursor is moved back to an edit made before it in its line, so
+// that it is still known afterwards.
+static void prepare_edit(File& file, size_t offset)
+{
+    const std::optional<LineStart>& line = file.cursor_line_start;
+    std::optional<LineColumn>& column = file.cursor_render_col;
+    if (!line || !column || offset < line->offset
+        || offset >= line->offset + column->col) {
+        return;
+    }
+    column = retreat_column(
+        file,
+        line->offset,
+        *column,
+        offset - line->offset,
+        0);
+}
+
+// Whether an edit of `length` bytes fits in the undo journal. The buffers of
+// the piece table never change, so the journal only references them and any
+// edit fits, while the text of the rope is copied in the journal.
+static bool fits_undo_journal(const File& file, size_t length)
+{
+    return std::holds_alternative<piece_table::PieceTable>(file.text)
+        || length <= state.undo_limit;
+}
+
+// Spans of the undo journal holding the text of [offset, offset + length)
+static void get_undo_spans(
+    File& file,
+    size_t offset,
+    size_t length,
+    std::vector<undo::Span>& spans)
+{
+    if (const auto* table = std::get_if<piece_table::PieceTable>(&file.text)) {
+        piece_table::for_each_piece(
+            *table,
+            offset,
+            length,
+            [&](piece_table::Source source, size_t start, size_t span_length) {
+                spans.push_back(undo::Span {
+                    .source = source == piece_table::Source::Original
+                        ? undo::Source::Original
+                        : undo::Source::Add,
+                    .start = start,
+                    .length = span_length,
+                });
+            });
+        return;
+    }
+    rope::for_each_span(
+        std::get<rope::Rope>(file.text),
+        offset,
+        length,
+        [&](std::string_view text) {
+            spans.push_back(undo::copy_text(file.undo_journal, text));
+        });
+}
+
+// Every edit of a file goes through these two functions, which record it in
+// the undo journal. Typing edits are coalesced with the previous ones.
+static void insert_text_at(
+    File& file,
+    size_t offset,
+    std::string_view text,
+    bool typing)
+{
+    undo::Journal& journal = file.undo_journal;
+    bool recorded = fits_undo_journal(file, text.size());
+    undo::Span inserted {};
+    if (const auto* table = std::get_if<piece_table::PieceTable>(&file.text)) {
+        // The text is appended to the add buffer
+        inserted = undo::Span {
+            .source = undo::Source::Add,
+            .start = piece_table::next_add_start(*table, text.size()),
+            .length = text.size(),
+        };
+    } else if (recorded) {
+        inserted = undo::copy_text(journal, text);
+    }
+    prepare_edit(file, offset);
+    visit_text(file, [&](auto& storage) { insert(storage, offset, text); });
+    if (recorded) {
+        undo::record(
+            journal,
+            offset,
+            {},
+            { &inserted, 1 },
+            typing,
+            state.undo_limit);
+    } else {
+        // The edits before this one can no longer be undone
+        undo::clear(journal);
+    }
+    mark_edited(file, offset);
+}
+
+static void erase_text_at(
+    File& file,
+    size_t offset,
+    size_t length,
+    bool typing)
+{
+    undo::Journal& journal = file.undo_journal;
+    bool recorded = fits_undo_journal(file, length);
+    std::vector<undo::Span> removed;
+    if (recorded) {
+        get_undo_spans(file, offset, length, removed);
+    }
+    prepare_edit(file, offset);
+    visit_text(file, [&](auto& storage) { erase(storage, offset, length); });
+    if (recorded) {
+        undo::record(journal, offset, removed, {}, typing, state.undo_limit);
+    } else {
+        undo::clear(journal);
+    }
+    mark_edited(file, offset);
+}
+
+// Replace `length` bytes at `offset` with the text of spans of the undo
+// journal, without recording it
+static void replace_text_at(
+    File& file,
+    size_t offset,
+    size_t length,
+    std::span<const undo::Span> spans)
+{
+    prepare_edit(file, offset);
+    visit_text(file, [&](auto& storage) { erase(storage, offset, length); });
+    size_t span_offset = offset;
+    for (const undo::Span& span : spans) {
+        if (span.source == undo::Source::Journal) {
+            std::string_view text = undo::span_text(file.undo_journal, span);
+            visit_text(file, [&](auto& storage) {
+                insert(storage, span_offset, text);
+            });
+        } else {
+            piece_table::insert_piece(
+                std::get<piece_table::PieceTable>(file.text),
+                span_offset,
+                span.source == undo::Source::Original
+                    ? piece_table::Source::Original
+                    : piece_table::Source::Add,
+                span.start,
+                span.length);
+        }
+        span_offset += span.length;
+    }
+    mark_edited(file, offset);
+}
+
+void insert_char(char c)
+{
+    insert_text_at(*state.viewed_file, get_cursor_offset(), { &c, 1 }, true);
+    state.cursor_coord.col++;
+}
+
+void insert_text(std::string_view text)
+{
+    if (text.empty()) {
+        return;
+    }
+    insert_text_at(*state.viewed_file, get_cursor_offset(), text, false);
+
+    Coord& cursor = state.cursor_coord;
+    size_t last_newline = text.rfind('\n');
+    if (last_newline == std::string_view::npos) {
+        cursor.col += text.size();
+    } else {
+        cursor.row += static_cast<size_t>(std::ranges::count(text, '\n'));
+        cursor.col = text.size() - last_newline - 1;
+    }
+}
+
+void insert_newline()
+{
+    // TODO handle newline type depending on settings
+    insert_text("\n");
+}
+
+void delete_char()
+{
+    File& file = *state.viewed_file;
+    size_t offset = get_cursor_offset();
+    size_t text_size
+        = visit_text(file, [](const auto& text) { return size(text); });
+    if (offset < text_size) {
+        // Erasing the newline ending the line joins it with the next one
+        size_t length
+            = char_length(file, state.cursor_coord.row, state.cursor_coord.col);
+        erase_text_at(file, offset, length, true);
+    }
+}
+
+void delete_char_before()
+{
+    Coord& cursor = state.cursor_coord;
+    if (cursor.col > 0) {
+        File& file = *state.viewed_file;
+        size_t start = char_start(file, cursor.row, cursor.col - 1);
+        size_t length = cursor.col - start;
+        erase_text_at(file, get_cursor_offset() - length, length, true);
+        cursor.col = start;
+    } else if (cursor.row > 0) {
+        // Join the line with the previous one
+        File& file = *state.viewed_file;
+        size_t previous_length = line_length(file, cursor.row - 1);
+        erase_text_at(file, get_cursor_offset() - 1, 1, true);
+        cursor.row--;
+        cursor.col = previous_length;
+    }
+}
+
+void undo()
+{
+    File& file = *state.viewed_file;
+    undo::Journal& journal = file.undo_journal;
+    std::span<const undo::Delta> deltas = undo::undo(journal);
+    if (deltas.empty()) {
+        return;
+    }
+    for (auto delta = deltas.rbegin(); delta != deltas.rend(); delta++) {
+        replace_text_at(
+            file,
+            delta->offset,
+            undo::spans_length(undo::inserted_spans(journal, *delta)),
+            undo::removed_spans(journal, *delta));
+    }
+    // Put the cursor after the restored text, which is where it was before the
+    // first edit unless deleting forward
+    const undo::Delta& first = deltas.front();
+    state.cursor_coord = get_offset_coord(
+        file,
+        first.offset + undo::spans_length(undo::removed_spans(journal, first)));
+}
+
+void redo()
+{
+    File& file = *state.viewed_file;
+    undo::Journal& journal = file.undo_journal;
+    std::span<const undo::Delta> deltas = undo::redo(journal);
+    if (deltas.empty()) {
+        return;
+    }
+    for (const undo::Delta& delta : deltas) {
+        replace_text_at(
+            file,
+            delta.offset,
+            undo::spans_length(undo::removed_spans(journal, delta)),
+            undo::inserted_spans(journal, delta));
+    }
+    const undo::Delta& last = deltas.back();
+    state.cursor_coord = get_offset_coord(
+        file,
+        last.offset + undo::spans_length(undo::inserted_spans(journal, last)));
+}
+
 void set_keymap(Key::Code keycode, KeyHandler* handler)
 {
     state.keymap[keycode] = handler;
@@ -165,24 +796,860 @@ KeyHandler* get_keymap(Key::Code keycode)
     return state.keymap[keycode];
 }
 
+size_t line_count(const File& file)
+{
+    return visit_text(file, [](const auto& text) { return line_count(text); });
+}
+
+bool has_line(const File& file, size_t row)
+{
+    return visit_text(
+        file,
+        [row](const auto& text) { return has_line(text, row); });
+}
+
+size_t line_length(const File& file, size_t row)
+{
+    return visit_text(
+        file,
+        [row](const auto& text) { return line_length(text, row); });
+}
+
+std::string_view text_range(
+    const File& file,
+    size_t offset,
+    size_t length,
+    std::string& scratch)
+{
+    std::string_view first_span;
+    size_t span_count = 0;
+    auto gather_span = [&](std::string_view span) {
+        if (span_count == 0) {
+            first_span = span;
+        } else {
+            if (span_count == 1) {
+                scratch.assign(first_span);
+            }
+            scratch.append(span);
+        }
+        span_count++;
+    };
+    visit_text(file, [&](const auto& text) {
+        for_each_span(text, offset, length, gather_span);
+    });
+    return span_count > 1 ? std::string_view(scratch) : first_span;
+}
+
+std::string_view line_text(
+    const File& file,
+    size_t row,
+    size_t col,
+    size_t length,
+    std::string& scratch)
+{
+    size_t line_len = line_length(file, row);
+    if (col >= line_len) {
+        return {};
+    }
+    size_t offset = col
+        + visit_text(
+            file,
+            [row](const auto& text) { return line_start(text, row); });
+    return text_range(file, offset, std::min(length, line_len - col), scratch);
+}
+
+size_t render_col(const File& file, size_t row, size_t col)
+{
+    if (!has_line(file, row)) {
+        return col;
+    }
+    size_t line_offset = get_line_start(file, row);
+    size_t end_col = std::min(col, line_length(file, row));
+    // Counted from the cursor when its column is known, rather than from the
+    // start of the line
+    LineColumn column {};
+    if (std::optional<LineColumn> cursor = cursor_column(file, row)) {
+        std::optional<LineColumn> before = cursor->col > end_col
+            ? retreat_column(file, line_offset, *cursor, end_col, 0)
+            : cursor;
+        if (before) {
+            column = *before;
+        }
+    }
+    column = advance_column(file, line_offset, column, end_col, SIZE_MAX);
+    // Past the end of the line
+    return column.render_col + (col - end_col);
+}
+
+LineColumn find_render_col(const File& file, size_t row, size_t render_col)
+{
+    size_t line_offset = get_line_start(file, row);
+    size_t line_len = line_length(file, row);
+    LineColumn column {};
+    if (std::optional<LineColumn> cursor = cursor_column(file, row)) {
+        if (cursor->render_col <= render_col) {
+            column = *cursor;
+        } else {
+            // Each character before the cursor takes one column unless a tab
+            // is crossed
+            size_t bytes = (cursor->render_col - render_col)
+                * utils::max_char_length;
+            std::optional<LineColumn> before = retreat_column(
+                file,
+                line_offset,
+                *cursor,
+                cursor->col - std::min(cursor->col, bytes),
+                render_col);
+            if (before && before->render_col <= render_col) {
+                return *before;
+            }
+        }
+    }
+    // Each character takes at most this many bytes, except in invalid text
+    // where the bytes are looked at by as many again
+    while (true) {
+        size_t bytes
+            = (render_col - column.render_col + 1) * utils::max_char_length;
+        size_t end_col = std::min(line_len, column.col + bytes);
+        column = advance_column(file, line_offset, column, end_col, render_col);
+        if (column.col < end_col || end_col == line_len) {
+            return column;
+        }
+    }
+}
+
+unsigned load_progress(const File& file)
+{
+    const auto* table = std::get_if<piece_table::PieceTable>(&file.text);
+    return table != nullptr ? piece_table::indexing_progress(*table) : 100;
+}
+
+// Files opened in the background by a few worker threads, each taking the next
+// path not opened yet until there is none left
+struct Loader {
+    std::vector<std::string> paths;
+    std::atomic<size_t> next_path = 0;
+    std::mutex mutex;
+    std::condition_variable progress;
+    // Files opened but not added to the opened files yet, with their rank in
+    // `paths`, or an error message and errno if they could not be opened
+    struct Result {
+        size_t rank;
+        std::unique_ptr<File> file;
+        std::string error;
+        int error_number;
+    };
+    std::vector<Result> results;
+    size_t pending = 0;
+    // Slot reserved for the file of each rank, so that the files are in the
+    // order of the paths whatever the order they are opened in, or
+    // FileHandle::invalid_index once the file failed to open
+    std::vector<uint32_t> slots;
+    // Wakes the main loop up when a file is opened
+    event_loop::SourceId notifier;
+    // Last member so that the workers are joined before the rest is destroyed
+    std::vector<std::jthread> workers;
+};
+
+static std::unique_ptr<Loader> loader;
+
+// Maximum number of files opened at the same time
+static constexpr unsigned max_loader_workers = 8;
+
+// Open a file without touching the state, so that it can be called from any
+// thread. Return false with an error message if the file cannot be opened.
+static bool load_file(
+    File& file,
+    const std::string& path,
+    const LoadOptions& options,
+    std::string& error)
+{
+    file.path = path;
+
+    os::MappedFile& mapping = file.mapping;
+    if (os::map_file(path.c_str(), mapping)) {
+        // Indexing the newlines scans the whole file once from the start, the
+        // advice is reset by update() if the file is indexed in the background
+        os::advise(mapping, 0, mapping.size, os::Advice::Sequential);
+        init_text(
+            file,
+            std::string_view(mapping.data, mapping.size),
+            options);
+        if (load_progress(file) == 100) {
+            os::advise(mapping, 0, mapping.size, os::Advice::Normal);
+        }
+        return true;
+    }
+
+    // Fallback for files that cannot be mapped, such as pipes
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.is_open()) {
+        error = std::format("Cannot open file {}", path);
+        return false;
+    }
+    file.loaded_text.assign(std::istreambuf_iterator<char>(stream), {});
+    if (stream.bad()) {
+        error = std::format("Cannot read file {}", path);
+        return false;
+    }
+    init_text(
+        file,
+        std::string_view(file.loaded_text.data(), file.loaded_text.size()),
+        options);
+    return true;
+}
+
+static void run_loader_worker(Loader& shared, LoadOptions options)
+{
+    for (size_t rank = shared.next_path++; rank < shared.paths.size();
+         rank = shared.next_path++) {
+        Loader::Result result {
+            .rank = rank,
+            .file = std::make_unique<File>(),
+            .error = {},
+            .error_number = 0,
+        };
+        if (!load_file(
+                *result.file,
+                shared.paths[rank],
+                options,
+                result.error)) {
+            result.error_number = errno;
+        }
+        {
+            std::scoped_lock lock(shared.mutex);
+            shared.results.push_back(std::move(result));
+        }
+        shared.progress.notify_all();
+        event_loop::notify(shared.notifier);
+    }
+}
+
+// Put a file in a free or reserved slot of the opened files
+static FileHandle fill_slot(uint32_t index, std::unique_ptr<File> file)
+{
+    OpenedFiles::Slot& slot = state.opened_files.slots[index];
+    slot.file = std::move(file);
+    return FileHandle { .index = index, .generation = slot.generation };
+}
+
+// Add the files opened by the loader so far to their slots. The files which
+// could not be opened are reported in the message and their slots freed.
+static void collect_loaded_files()
+{
+    std::vector<Loader::Result> results;
+    {
+        std::scoped_lock lock(loader->mutex);
+        results = std::exchange(loader->results, {});
+    }
+    for (Loader::Result& result : results) {
+        loader->pending--;
+        uint32_t& index = loader->slots[result.rank];
+        if (result.error.empty()) {
+            fill_slot(index, std::move(result.file));
+            continue;
+        }
+        std::string error = std::format(
+            "{}: {}",
+            result.error,
+            std::strerror(result.error_number));
+        state.message = state.message.empty()
+            ? std::move(error)
+            : std::format("{}; {}", state.message, error);
+        state.opened_files.free_slots.push_back(index);
+        index = FileHandle::invalid_index;
+    }
+}
+
+static void stop_loader()
+{
+    // The workers are joined before the notifier they use is removed
+    event_loop::SourceId notifier = loader->notifier;
+    loader.reset();
+    event_loop::remove(notifier);
+}
+
+// A file written in the background by its own thread, from a snapshot of its
+// text taken when the save started, so that the file can be edited meanwhile
+struct SaveJob {
+    FileHandle handle;
+    std::string path;
+    std::variant<piece_table::Snapshot, rope::Rope> text;
+    size_t size = 0;
+    // Mapped file holding the original buffer of the piece table, from which
+    // the ranges still holding the text are copied, or nullptr
+    const os::MappedFile* mapping = nullptr;
+    // Copy of File::overwritten, to which the thread adds the ranges it
+    // rewrites in place
+    std::vector<ByteRange> overwritten;
+    // Whether only the edited ranges of the file are written, in place. Set if
+    // the file allows it, and cleared by the thread if too much of the file
+    // would be rewritten.
+    bool in_place = false;
+    // Set by the thread, `error_number` being written before `done`
+    std::atomic<size_t> written = 0;
+    std::atomic<bool> done = false;
+    int error_number = 0;
+    // Whether the file was saved again while being saved, the next save
+    // starting once this one is done
+    bool save_again = false;
+    // Last member so that the thread is joined before the rest is destroyed
+    std::jthread thread;
+};
+
+static std::vector<std::unique_ptr<SaveJob>> save_jobs;
+
+// Wakes the main loop up when a save is done, added by the first save
+static std::optional<event_loop::SourceId> save_notifier;
+
+// Spans are written in chunks of at most this size, so that the progress of
+// a save is updated regularly even when the text is a few large spans
+static constexpr size_t save_chunk_size = size_t { 1 } * 1024 * 1024;
+
+// Ranges of the mapped file shorter than this are written from memory rather
+// than copied, as each copy takes a system call
+static constexpr size_t min_copied_length = size_t { 64 } * 1024;
+
+// Saves rewriting more than this in place write a new file instead, as the
+// mapping would need its own copy of as much of the file in memory
+static constexpr size_t max_rewritten_length = size_t { 64 } * 1024 * 1024;
+
+// Write text at `offset` in the new content of the file, which is appended to
+// it unless written in place
+static bool write_text(
+    SaveJob& job,
+    os::FileWriter& writer,
+    size_t offset,
+    std::string_view text)
+{
+    while (!text.empty()) {
+        std::string_view chunk = text.substr(0, save_chunk_size);
+        bool written = job.in_place ? os::write_at(writer, offset, chunk)
+                                    : os::write(writer, chunk);
+        if (!written) {
+            return false;
+        }
+        job.written += chunk.size();
+        offset += chunk.size();
+        text.remove_prefix(chunk.size());
+    }
+    return true;
+}
+
+// Call `visitor(start, end, on_disk)` with the consecutive parts of the range
+// [start, end) of the mapped file, `on_disk` telling whether the file still
+// holds the text of the mapping there
+template<class Visitor>
+static void split_overwritten(
+    std::span<const ByteRange> overwritten,
+    size_t start,
+    size_t end,
+    Visitor&& visitor)
+{
+    auto range = std::ranges::partition_point(
+        overwritten,
+        [start](const ByteRange& range) { return range.end <= start; });
+    for (; range != overwritten.end() && range->start < end; range++) {
+        if (start < range->start) {
+            visitor(start, range->start, true);
+            start = range->start;
+        }
+        size_t overwritten_end = std::min(end, range->end);
+        visitor(start, overwritten_end, false);
+        start = overwritten_end;
+    }
+    if (start < end) {
+        visitor(start, end, true);
+    }
+}
+
+// Write the pieces of a snapshot. The ranges of the mapped file still holding
+// their text are copied from the file, or left untouched if written in place
+// at the same offset, so that only the edited ranges go through memory.
+static bool write_pieces(
+    SaveJob& job,
+    os::FileWriter& writer,
+    const piece_table::Snapshot& snapshot)
+{
+    size_t offset = 0;
+    bool written = true;
+    piece_table::for_each_piece(
+        snapshot,
+        [&](piece_table::Source source, size_t piece_start, size_t length) {
+            std::string_view text = piece_table::source_text(
+                snapshot,
+                source,
+                piece_start,
+                length);
+            bool from_file = job.mapping != nullptr
+                && source == piece_table::Source::Original
+                && (job.in_place ? piece_start == offset
+                                 : length >= min_copied_length);
+            if (!written) {
+                // Skip the remaining pieces
+            } else if (!from_file) {
+                written = write_text(job, writer, offset, text);
+            } else {
+                split_overwritten(
+                    job.overwritten,
+                    piece_start,
+                    piece_start + length,
+                    [&](size_t start, size_t end, bool on_disk) {
+                        std::string_view part
+                            = text.substr(start - piece_start, end - start);
+                        size_t part_offset = offset + (start - piece_start);
+                        if (!written) {
+                            return;
+                        }
+                        if (!on_disk
+                            || (!job.in_place
+                                && part.size() < min_copied_length)) {
+                            written
+                                = write_text(job, writer, part_offset, part);
+                        } else if (job.in_place) {
+                            // Already in the file
+                            job.written += part.size();
+                        } else {
+                            written = os::copy_range(
+                                writer,
+                                *job.mapping,
+                                start,
+                                part.size());
+                            job.written += part.size();
+                        }
+                    });
+            }
+            offset += length;
+        });
+    return written;
+}
+
+// Add the ranges that a save in place of a snapshot rewrites, the ones not
+// holding the text of the mapped file at the same offset, to the overwritten
+// ranges of the job, and give the mapping its own copy of them beforehand.
+// Fall back to writing a new file if they are too large.
+static bool mark_overwritten(
+    SaveJob& job,
+    const piece_table::Snapshot& snapshot)
+{
+    std::vector<ByteRange> rewritten;
+    size_t rewritten_length = 0;
+    size_t offset = 0;
+    piece_table::for_each_piece(
+        snapshot,
+        [&](piece_table::Source source, size_t start, size_t length) {
+            if (source != piece_table::Source::Original || start != offset) {
+                rewritten.push_back({ offset, offset + length });
+                rewritten_length += length;
+            }
+            offset += length;
+        });
+    if (rewritten_length > max_rewritten_length) {
+        job.in_place = false;
+        return true;
+    }
+    for (const ByteRange& range : rewritten) {
+        size_t length = range.end - range.start;
+        if (!os::privatize(*job.mapping, range.start, length)) {
+            return false;
+        }
+    }
+    std::vector<ByteRange>& ranges = job.overwritten;
+    ranges.insert(ranges.end(), rewritten.begin(), rewritten.end());
+    std::ranges::sort(ranges, {}, &ByteRange::start);
+    size_t merged = 0;
+    for (const ByteRange& range : ranges) {
+        ByteRange* last = merged > 0 ? &ranges[merged - 1] : nullptr;
+        if (last != nullptr && range.start <= last->end) {
+            last->end = std::max(last->end, range.end);
+        } else {
+            ranges[merged++] = range;
+        }
+    }
+    ranges.resize(merged);
+    return true;
+}
+
+static void run_save_job(SaveJob& job)
+{
+    os::FileWriter writer;
+    const auto* table = std::get_if<piece_table::Snapshot>(&job.text);
+    // Only the snapshots of a piece table are saved in place
+    bool saved = !job.in_place || mark_overwritten(job, *table);
+    saved = saved
+        && (job.in_place ? os::open_in_place(writer, job.path.c_str())
+                         : os::open_writer(writer, job.path.c_str()));
+    if (!saved) {
+        // Nothing to write
+    } else if (table != nullptr) {
+        saved = write_pieces(job, writer, *table);
+    } else {
+        const auto& rope = std::get<rope::Rope>(job.text);
+        rope::for_each_span(
+            rope,
+            0,
+            rope::size(rope),
+            [&](std::string_view span) {
+                saved = saved && write_text(job, writer, 0, span);
+            });
+    }
+    saved = saved && os::commit(writer);
+    job.error_number = saved ? 0 : errno;
+    job.done = true;
+    event_loop::notify(*save_notifier);
+}
+
+// Saves still running when the program exits are completed first
+static void wait_for_all_saves()
+{
+    for (const std::unique_ptr<SaveJob>& job : save_jobs) {
+        if (job->thread.joinable()) {
+            job->thread.join();
+        }
+    }
+}
+
+static void start_save(FileHandle handle)
+{
+    if (!save_notifier) {
+        save_notifier = event_loop::add_notifier(nullptr, nullptr);
+        os::at_exit(os::Ring::_1, wait_for_all_saves);
+    }
+    File& file = *get_file(handle);
+    auto job = std::make_unique<SaveJob>();
+    job->handle = handle;
+    job->path = file.path;
+    job->text = visit_text(
+        file,
+        [](const auto& text)
+            -> std::variant<piece_table::Snapshot, rope::Rope> {
+            return snapshot(text);
+        });
+    job->size = visit_text(file, [](const auto& text) { return size(text); });
+    const auto* snapshot = std::get_if<piece_table::Snapshot>(&job->text);
+    const os::MappedFile& mapping = file.mapping;
+    if (snapshot != nullptr && mapping.fd != -1 && mapping.size > 0
+        && snapshot->original.data() == mapping.data) {
+        job->mapping = &mapping;
+        // Writing in place is only possible if the file was not replaced
+        job->in_place = job->size == mapping.size
+            && os::is_same_file(mapping, file.path.c_str());
+        job->overwritten = file.overwritten;
+    }
+    job->thread = std::jthread(run_save_job, std::ref(*job));
+    save_jobs.push_back(std::move(job));
+}
+
+// Take the result of a completed save
+static void finish_save(const SaveJob& job)
+{
+    // Even a failed save may have overwritten part of the file in place
+    File* file = get_file(job.handle);
+    if (job.in_place && file != nullptr) {
+        file->overwritten = job.overwritten;
+    }
+    std::string message = job.error_number == 0
+        ? std::string("saved")
+        : std::format("cannot save: {}", std::strerror(job.error_number));
+    if (job.handle != state.viewed_handle) {
+        message = std::format("{}: {}", job.path, message);
+    }
+    state.message = std::move(message);
+}
+
+// Report the saves done since the last call, and start the saves requested
+// while the same file was being saved
+static void collect_saved_files()
+{
+    std::vector<FileHandle> saved_again;
+    for (auto it = save_jobs.begin(); it != save_jobs.end();) {
+        SaveJob& job = **it;
+        if (!job.done) {
+            it++;
+            continue;
+        }
+        finish_save(job);
+        if (job.save_again) {
+            saved_again.push_back(job.handle);
+        }
+        it = save_jobs.erase(it);
+    }
+    for (FileHandle handle : saved_again) {
+        if (get_file(handle) != nullptr) {
+            start_save(handle);
+        }
+    }
+}
+
+// The snapshot of a file is allocated from its storage, so the saves of a file
+// are completed, including the one queued, and their jobs destroyed before the
+// file is closed
+static void wait_for_saves(FileHandle handle)
+{
+    while (true) {
+        auto it = std::ranges::find_if(
+            save_jobs,
+            [handle](const std::unique_ptr<SaveJob>& job) {
+                return job->handle == handle;
+            });
+        if (it == save_jobs.end()) {
+            return;
+        }
+        SaveJob& job = **it;
+        job.thread.join();
+        finish_save(job);
+        bool save_again = job.save_again;
+        save_jobs.erase(it);
+        if (save_again) {
+            start_save(handle);
+        }
+    }
+}
+
+void save_file(FileHandle handle)
+{
+    const File* file = get_file(handle);
+    if (file == nullptr) {
+        return;
+    }
+    if (file->path.empty()) {
+        state.message = "cannot save a file without name";
+        return;
+    }
+    auto running = std::ranges::find_if(
+        save_jobs,
+        [handle](const std::unique_ptr<SaveJob>& job) {
+            return job->handle == handle;
+        });
+    if (running != save_jobs.end()) {
+        (*running)->save_again = true;
+        return;
+    }
+    start_save(handle);
+}
+
+bool is_saving()
+{
+    return !save_jobs.empty();
+}
+
+unsigned save_progress(FileHandle handle)
+{
+    for (const std::unique_ptr<SaveJob>& job : save_jobs) {
+        if (job->handle == handle && job->size > 0) {
+            return static_cast<unsigned>(job->written * 100 / job->size);
+        }
+    }
+    return 100;
+}
+
+bool is_loading()
+{
+    if (loader) {
+        return true;
+    }
+    return std::ranges::any_of(
+        state.opened_files.slots,
+        [](const OpenedFiles::Slot& slot) {
+            if (!slot.file) {
+                return false;
+            }
+            const auto* table
+                = std::get_if<piece_table::PieceTable>(&slot.file->text);
+            return table != nullptr && piece_table::is_indexing(*table);
+        });
+}
+
+void update()
+{
+    if (loader) {
+        collect_loaded_files();
+        if (loader->pending == 0) {
+            stop_loader();
+        }
+    }
+    collect_saved_files();
+    for (OpenedFiles::Slot& slot : state.opened_files.slots) {
+        if (!slot.file) {
+            continue;
+        }
+        File& file = *slot.file;
+        auto* table = std::get_if<piece_table::PieceTable>(&file.text);
+        if (table != nullptr && piece_table::is_indexing(*table)
+            && piece_table::indexing_progress(*table) == 100) {
+            piece_table::finish_indexing(*table);
+            os::advise(file.mapping, 0, file.mapping.size, os::Advice::Normal);
+        }
+    }
+}
+
+FileHandle add_file(std::unique_ptr<File> file)
+{
+    OpenedFiles& files = state.opened_files;
+    uint32_t index = 0;
+    if (files.free_slots.empty()) {
+        index = static_cast<uint32_t>(files.slots.size());
+        files.slots.emplace_back();
+    } else {
+        index = files.free_slots.back();
+        files.free_slots.pop_back();
+    }
+    return fill_slot(index, std::move(file));
+}
+
+File* get_file(FileHandle handle)
+{
+    OpenedFiles& files = state.opened_files;
+    if (handle.index >= files.slots.size()) {
+        return nullptr;
+    }
+    OpenedFiles::Slot& slot = files.slots[handle.index];
+    if (slot.generation != handle.generation) {
+        return nullptr;
+    }
+    return slot.file.get();
+}
+
+void close_file(FileHandle handle)
+{
+    if (get_file(handle) == nullptr) {
+        return;
+    }
+    wait_for_saves(handle);
+    if (handle.index == state.viewed_handle.index) {
+        view_next_file();
+    }
+    OpenedFiles& files = state.opened_files;
+    OpenedFiles::Slot& slot = files.slots[handle.index];
+    slot.file.reset();
+    slot.generation++;
+    files.free_slots.push_back(handle.index);
+    // Always keep a file to view
+    if (state.viewed_handle.index == handle.index) {
+        state.viewed_handle = {};
+        state.viewed_file = nullptr;
+        open_new_file();
+    }
+}
+
 void open_new_file()
 {
-    state.viewed_file = &state.opened_files.emplace_back();
+    auto file = std::make_unique<File>();
     // TODO handle newline type depending on settings
-    state.viewed_file->lines.emplace_back("\r\n");
+    init_text(*file, {}, get_load_options());
+    view_file(add_file(std::move(file)));
 }
 void open_file(const char* path)
 {
-    state.viewed_file = &state.opened_files.emplace_back();
+    auto file = std::make_unique<File>();
+    std::string error;
+    if (!load_file(*file, path, get_load_options(), error)) {
+        os::exit_err(error.c_str());
+    }
+    view_file(add_file(std::move(file)));
+}
+
+void open_files(std::span<const std::string> paths)
+{
+    if (paths.empty()) {
+        return;
+    }
+    if (paths.size() == 1) {
+        open_file(paths.front().c_str());
+        return;
+    }
+
+    loader = std::make_unique<Loader>();
+    loader->paths.assign(paths.begin(), paths.end());
+    loader->pending = paths.size();
+    // New slots, following the ones of the files already opened
+    OpenedFiles& files = state.opened_files;
+    for (size_t rank = 0; rank < paths.size(); rank++) {
+        loader->slots.push_back(static_cast<uint32_t>(files.slots.size()));
+        files.slots.emplace_back();
+    }
+    loader->notifier = event_loop::add_notifier(nullptr, nullptr);
+    size_t worker_count = std::min<size_t>(
+        { std::max(std::thread::hardware_concurrency(), 1U),
+          max_loader_workers,
+          paths.size() });
+    for (size_t index = 0; index < worker_count; index++) {
+        loader->workers.emplace_back(
+            run_loader_worker,
+            std::ref(*loader),
+            get_load_options());
+    }
 
-    std::fstream file(path);
-    if (!file.is_open()) {
-        os::exit_err_format("Cannot open file {}", path);
+    // View the first file which can be opened, waiting for the files given
+    // before it only, the others are collected by update()
+    size_t rank = 0;
+    while (true) {
+        collect_loaded_files();
+        while (rank < paths.size()
+               && loader->slots[rank] == FileHandle::invalid_index) {
+            rank++;
+        }
+        if (rank == paths.size()) {
+            // None could be opened, the message telling why
+            open_new_file();
+            return;
+        }
+        uint32_t index = loader->slots[rank];
+        if (files.slots[index].file) {
+            view_file(FileHandle {
+                .index = index,
+                .generation = files.slots[index].generation,
+            });
+            return;
+        }
+        std::unique_lock lock(loader->mutex);
+        loader->progress.wait(lock, [] { return !loader->results.empty(); });
     }
+}
 
-    for (std::string line; std::getline(file, line);) {
-        state.viewed_file->lines.emplace_back(line);
+void view_file(FileHandle handle)
+{
+    File* file = get_file(handle);
+    if (file == nullptr) {
+        return;
     }
+    // Save the position in the file viewed so far
+    if (state.viewed_file != nullptr) {
+        state.viewed_file->cursor_coord = state.cursor_coord;
+        state.viewed_file->viewport_offset = state.viewport_offset;
+    }
+    state.viewed_handle = handle;
+    state.viewed_file = file;
+    state.cursor_coord = file->cursor_coord;
+    state.viewport_offset = file->viewport_offset;
+}
+
+// View the next opened file in the slot order, `step` being 1 to go forward
+// and the slot count minus 1 to go backward
+static void view_file_after(size_t step)
+{
+    const auto& slots = state.opened_files.slots;
+    size_t index = state.viewed_handle.index;
+    for (size_t tries = 1; tries < slots.size(); tries++) {
+        index = (index + step) % slots.size();
+        if (slots[index].file) {
+            view_file(FileHandle {
+                .index = static_cast<uint32_t>(index),
+                .generation = slots[index].generation,
+            });
+            return;
+        }
+    }
+}
+
+void view_next_file()
+{
+    view_file_after(1);
+}
+
+void view_previous_file()
+{
+    view_file_after(state.opened_files.slots.size() - 1);
 }
 
 } // namespace ted::editor
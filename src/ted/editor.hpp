@@ -2,13 +2,23 @@
 #define TED_EDITOR_HPP_
 
 #include <ted/key.hpp>
+#include <ted/os.hpp>
+#include <ted/piece_table.hpp>
+#include <ted/rope.hpp>
+#include <ted/undo.hpp>
 #include <ted/utils.hpp>
 
 #include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #define TED_VERSION_MAJOR 0
@@ -24,28 +34,127 @@ namespace ted::editor {
 using KeyHandler = void(void* userdata);
 using KeyMap = std::array<KeyHandler*, std::to_underlying(Key::Count)>;
 
-struct File {
-    std::vector<std::string> lines;
+// Backend used to store the text of files opened afterwards
+enum class Storage : uint8_t {
+    PieceTable,
+    Rope,
 };
 
 struct ScreenSize {
     size_t rows {};
     size_t cols {};
+
+    bool operator==(const ScreenSize&) const = default;
 };
 
 struct Coord {
     size_t row {};
     size_t col {};
+
+    bool operator==(const Coord&) const = default;
+};
+
+struct ByteRange {
+    size_t start {};
+    size_t end {};
+};
+
+struct LineStart {
+    size_t row {};
+    size_t offset {};
+};
+
+// Byte of a line and the display column it is shown at
+struct LineColumn {
+    size_t col {};
+    size_t render_col {};
+};
+
+struct File {
+    // Storage of the text, released at once when the file is closed. Declared
+    // first so that it outlives the text allocated from it.
+    std::pmr::unsynchronized_pool_resource memory;
+    std::string path;
+    // Text as loaded, either mapped in memory or read when the file cannot be
+    // mapped. The piece table keeps referencing it as its original buffer.
+    // When its lines are interned, `loaded_text` only holds the distinct lines
+    // instead and the file is not kept mapped.
+    os::MappedFile mapping;
+    std::vector<char> loaded_text;
+    std::variant<piece_table::PieceTable, rope::Rope> text;
+    // Incremented by each edit of the text
+    uint64_t revision = 0;
+    // Start of the line of the cursor, when last looked up. Edits following
+    // it keep it, so that typing does not look it up again at each key.
+    std::optional<LineStart> cursor_line_start;
+    // Display column of a byte of that line, the one of the cursor when last
+    // looked up. Edits following it keep it, so that the display column of the
+    // cursor and of the columns near it is not computed from the start of the
+    // line at each frame.
+    std::optional<LineColumn> cursor_render_col;
+    undo::Journal undo_journal;
+    // Ranges of the mapped file overwritten in place by saves, sorted and
+    // disjoint. The file no longer holds the text of the mapping there, while
+    // the mapping keeps its own copy of it.
+    std::vector<ByteRange> overwritten;
+    // Position in the file saved while another file is viewed
+    Coord cursor_coord;
+    Coord viewport_offset;
+
+    File() = default;
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+    ~File();
+};
+
+// Handle to an opened file, telling apart the successive files stored in the
+// same slot of the opened files so that the handles of closed files are never
+// mistaken for the ones of files opened later on
+struct FileHandle {
+    static constexpr uint32_t invalid_index = UINT32_MAX;
+
+    uint32_t index = invalid_index;
+    uint32_t generation = 0;
+
+    bool operator==(const FileHandle&) const = default;
+};
+
+// Each opened file lives in its own allocation so that opening or closing a
+// file never moves the others, the slots of closed files being reused
+struct OpenedFiles {
+    struct Slot {
+        std::unique_ptr<File> file;
+        uint32_t generation = 0;
+    };
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
 };
 
 struct State {
-    std::vector<File> opened_files;
+    OpenedFiles opened_files;
+    FileHandle viewed_handle;
+    // Cached from viewed_handle
     File* viewed_file;
     std::string screen_buffer;
     ScreenSize screen_size;
     Coord cursor_coord;
+    // Its column is a display column, counting tabs as expanded
     Coord viewport_offset;
     char eob_char;
+    // Tabs are shown up to the next multiple of this number of columns
+    size_t tab_stop;
+    Storage storage;
+    // Keep each distinct line of the files opened afterwards once, for files
+    // stored in a piece table
+    bool intern_lines;
+    // Maximum number of frames drawn per second, unlimited if 0
+    unsigned max_fps;
+    // Use the kitty keyboard protocol if the terminal supports it
+    bool kitty_keyboard;
+    // Maximum number of bytes of undo history kept per file
+    size_t undo_limit;
+    // Shown in the status bar until the next key is pressed
+    std::string message;
     KeyMap keymap;
 };
 
@@ -73,18 +182,118 @@ void set_cursor_col(size_t col);
 void set_cursor_col_left();
 void set_cursor_col_right();
 size_t get_cursor_col();
+// Display column of the cursor in its line
+size_t get_cursor_render_col();
 
 void set_screen_rows(size_t rows);
 size_t get_screen_rows();
 void set_screen_cols(size_t cols);
 size_t get_screen_cols();
 
+// Edit the viewed file at the cursor, each call being a single edit. Inserting
+// moves the cursor past the inserted text.
+void insert_char(char c);
+void insert_text(std::string_view text);
+// Split the line at the cursor
+void insert_newline();
+// Erase the character under the cursor, joining the line with the next one at
+// the end of the line
+void delete_char();
+// Erase the character before the cursor, joining the line with the previous
+// one at the start of the line
+void delete_char_before();
+
+// Revert the last group of edits of the viewed file, or apply again the last
+// one reverted. Typing at the same place forms a single group.
+void undo();
+void redo();
+
 void set_keymap(Key::Code keycode, KeyHandler* handler);
 KeyHandler* get_keymap(Key::Code keycode);
 
+// Large files are shown before being fully loaded: the lines needed for the
+// first screen are indexed right away and the rest in the background. Line
+// accesses past the part already indexed wait for the indexing to reach them.
+// Prefer has_line() to line_count() as the latter waits for the whole file.
+size_t line_count(const File& file);
+bool has_line(const File& file, size_t row);
+size_t line_length(const File& file, size_t row);
+
+// Write a file to its path in the background, from a snapshot of its text
+// taken right away, so that the file can still be edited while it is written.
+// The file is replaced atomically, the ranges of a piece table still holding
+// the text of the mapped file being copied by the file system. If its size is
+// unchanged, only the edited ranges are written in place instead. The outcome
+// is reported in the message by update(), and the saves still running when the
+// program exits are waited for.
+void save_file(FileHandle handle);
+// Whether any of the files is being saved
+bool is_saving();
+// Percentage of the running save of a file written so far, 100 if none
+unsigned save_progress(FileHandle handle);
+
+// Percentage of the file loaded so far
+unsigned load_progress(const File& file);
+// Whether any of the files is still being opened or loaded
+bool is_loading();
+// Add the files opened in the background since the last call to the opened
+// files, complete the loading of the ones indexed in the background and report
+// the saves done. To be called regularly from the main loop.
+void update();
+
+// Return at most `length` bytes of the range of text starting at `offset`.
+// The returned view points directly into the file storage when the range is
+// contiguous there, otherwise the range is gathered into `scratch`. In both
+// cases the view is invalidated by the next edit of the file.
+std::string_view text_range(
+    const File& file,
+    size_t offset,
+    size_t length,
+    std::string& scratch);
+
+// Same as text_range() for at most `length` bytes of the line `row` starting
+// at column `col`, never including the newline character
+std::string_view line_text(
+    const File& file,
+    size_t row,
+    size_t col,
+    size_t length,
+    std::string& scratch);
+
+// Display column of the byte `col` of the line `row`, each character taking one
+// column and tabs being expanded to the next tab stop
+[[nodiscard]]
+size_t render_col(const File& file, size_t row, size_t col);
+
+// Character of the line `row` shown on the display column `render_col`, with
+// the display column it starts at, which is before `render_col` for a tab
+// spanning it. The end of the line if it ends before.
+[[nodiscard]]
+LineColumn find_render_col(const File& file, size_t row, size_t render_col);
+
 void open_new_file();
 void open_file(const char* path);
 
+// Open several files concurrently on a few worker threads. Return once the
+// first file which can be opened is viewed, the others being added by update()
+// as they become ready. The files keep the order of the paths among the opened
+// files, and the ones which cannot be opened are reported in the message.
+void open_files(std::span<const std::string> paths);
+
+// Take ownership of a file, return its handle
+FileHandle add_file(std::unique_ptr<File> file);
+// Return the file of a handle, or nullptr if it was closed
+[[nodiscard]]
+File* get_file(FileHandle handle);
+// Close a file once its running saves are done, viewing another opened file if
+// it was viewed, or a new file if it was the last one
+void close_file(FileHandle handle);
+void view_file(FileHandle handle);
+
+// Cycle through the opened files
+void view_next_file();
+void view_previous_file();
+
 } // namespace ted::editor
 
 #endif // TED_EDITOR_HPP_
@@ -0,0 +1,54 @@
+#ifndef TED_EVENT_LOOP_HPP_
+#define TED_EVENT_LOOP_HPP_
+
+#include <cstdint>
+
+namespace ted::event_loop {
+
+// Called from run_once() on the main thread when an event of its source occurs
+using Handler = void(void* userdata);
+
+// Identifier of a source of events
+using SourceId = uint32_t;
+
+// Sources of events waited for at once by the main thread: file descriptors
+// becoming readable, signals, timers and notifications from other threads.
+// Nothing is polled, so that no CPU is used while waiting.
+// A null handler only wakes the main thread up.
+void init();
+
+// Watch a file descriptor, not owned by the loop, becoming readable. A hung up
+// descriptor would be reported ready forever, so once it is hung up or in
+// error it is no longer watched and `hangup_handler` is called instead.
+SourceId add_fd(
+    int fd,
+    Handler* handler,
+    Handler* hangup_handler,
+    void* userdata);
+
+// Handle a signal in the loop rather than in a signal handler. The signal is
+// blocked, which must be done before any thread is started so that they
+// inherit it.
+SourceId add_signal(int signal, Handler* handler, void* userdata);
+
+// Add a timer, disarmed until set_timer() is called
+[[nodiscard]]
+SourceId add_timer(Handler* handler, void* userdata);
+// Trigger a timer every `interval_ms` milliseconds, or disarm it if 0
+void set_timer(SourceId timer, int interval_ms);
+
+// Add a source triggered by notify()
+[[nodiscard]]
+SourceId add_notifier(Handler* handler, void* userdata);
+// Trigger a notifier. Can be called from any thread.
+void notify(SourceId notifier);
+
+void remove(SourceId source);
+
+// Wait at most `timeout_ms` milliseconds, or forever if negative, for events
+// and call the handlers of their sources. Return false on timeout.
+bool run_once(int timeout_ms);
+
+} // namespace ted::event_loop
+
+#endif // TED_EVENT_LOOP_HPP_
@@ -0,0 +1,296 @@
+#include <ted/editor.hpp>
+#include <ted/grid.hpp>
+#include <ted/term.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace ted::grid {
+
+// Unchanged cells between two changed ones are sent again rather than skipped
+// over when this is shorter than moving the cursor
+static constexpr size_t max_resent_gap = 8;
+
+void reset(Grid& grid, size_t rows, size_t cols)
+{
+    grid.rows = rows;
+    grid.cols = cols;
+    grid.cells.assign(rows * cols, Cell {});
+}
+
+// Length of the UTF-8 character starting with a byte, 0 if none does
+static size_t char_length(char first)
+{
+    auto byte = static_cast<unsigned char>(first);
+    if (byte < 0x80) {
+        return 1;
+    }
+    // Continuation bytes, and the bytes starting overlong or out of range
+    // sequences
+    if (byte < 0xc2 || byte > 0xf4) {
+        return 0;
+    }
+    return byte < 0xe0 ? 2 : byte < 0xf0 ? 3 : 4;
+}
+
+// Cell of the character starting at `index` in `text`, which is then moved past
+// it. Control characters and invalid sequences are shown as '?'.
+static Cell next_cell(std::string_view text, size_t& index, Attribute attribute)
+{
+    size_t start = index++;
+    while (index < text.size() && utils::is_continuation_byte(text[index])) {
+        index++;
+    }
+    std::string_view bytes = text.substr(start, index - start);
+    auto first = static_cast<unsigned char>(bytes[0]);
+    // C1 control characters are encoded from C2 80 to C2 9F
+    bool control = first < 0x20 || first == 0x7f
+        || (first == 0xc2 && bytes.size() > 1
+            && static_cast<unsigned char>(bytes[1]) < 0xa0);
+    Cell cell { .bytes = { '?' }, .attribute = attribute };
+    if (bytes.size() == char_length(bytes[0]) && !control) {
+        std::ranges::copy(bytes, cell.bytes.begin());
+    }
+    return cell;
+}
+
+static Cell* row_cells(Grid& grid, size_t row)
+{
+    return grid.cells.data() + (row * grid.cols);
+}
+
+static const Cell* row_cells(const Grid& grid, size_t row)
+{
+    return grid.cells.data() + (row * grid.cols);
+}
+
+size_t put(
+    Grid& grid,
+    size_t row,
+    size_t col,
+    std::string_view text,
+    Attribute attribute)
+{
+    if (row >= grid.rows || col >= grid.cols) {
+        return col;
+    }
+    Cell* cells = row_cells(grid, row);
+    size_t index = 0;
+    while (index < text.size() && col < grid.cols) {
+        cells[col++] = next_cell(text, index, attribute);
+    }
+    return col;
+}
+
+void put_line(
+    Grid& grid,
+    size_t row,
+    std::string_view text,
+    size_t text_col,
+    size_t first_col,
+    size_t tab_stop)
+{
+    if (row >= grid.rows) {
+        return;
+    }
+    Cell* cells = row_cells(grid, row);
+    size_t end_col = first_col + grid.cols;
+    size_t col = text_col;
+    size_t index = 0;
+    while (index < text.size() && col < end_col) {
+        if (text[index] == '\t') {
+            // Drawn as the blank cells already there
+            col += tab_stop - (col % tab_stop);
+            index++;
+            while (index < text.size()
+                   && utils::is_continuation_byte(text[index])) {
+                index++;
+            }
+            continue;
+        }
+        Cell cell = next_cell(text, index, Attribute::None);
+        if (col >= first_col) {
+            cells[col - first_col] = cell;
+        }
+        col++;
+    }
+}
+
+void begin_frame(Renderer& renderer, size_t rows, size_t cols)
+{
+    if (renderer.front.rows != rows || renderer.front.cols != cols) {
+        renderer.front_valid = false;
+    }
+    reset(renderer.back, rows, cols);
+}
+
+void scroll(Renderer& renderer, size_t top, size_t bottom, std::ptrdiff_t rows)
+{
+    Grid& front = renderer.front;
+    bottom = std::min(bottom, front.rows);
+    size_t count = rows > 0 ? static_cast<size_t>(rows)
+                            : static_cast<size_t>(-rows);
+    if (!renderer.front_valid || top >= bottom || count == 0
+        || count >= bottom - top) {
+        return;
+    }
+
+    // The present() calls leave the attributes reset, so the exposed rows are
+    // blank as expected
+    term::set_scroll_region(top, bottom);
+    auto region_begin
+        = front.cells.begin() + static_cast<std::ptrdiff_t>(top * front.cols);
+    auto region_end = front.cells.begin()
+        + static_cast<std::ptrdiff_t>(bottom * front.cols);
+    auto shift = static_cast<std::ptrdiff_t>(count * front.cols);
+    if (rows > 0) {
+        term::scroll_up(count);
+        std::copy(region_begin + shift, region_end, region_begin);
+        std::fill(region_end - shift, region_end, Cell {});
+    } else {
+        term::scroll_down(count);
+        std::copy_backward(region_begin, region_end - shift, region_end);
+        std::fill(region_begin, region_begin + shift, Cell {});
+    }
+    term::reset_scroll_region();
+}
+
+void invalidate(Renderer& renderer)
+{
+    renderer.front_valid = false;
+}
+
+// What the terminal is known to be set to while a frame is sent
+struct Output {
+    size_t row = 0;
+    size_t col = 0;
+    bool position_known = false;
+    Attribute attribute = Attribute::None;
+};
+
+static void move_to(Output& output, size_t row, size_t col)
+{
+    if (output.position_known && output.row == row && output.col == col) {
+        return;
+    }
+    term::cursor_move(row, col);
+    output.row = row;
+    output.col = col;
+    output.position_known = true;
+}
+
+static void set_attribute(Output& output, Attribute attribute)
+{
+    if (output.attribute == attribute) {
+        return;
+    }
+    switch (attribute) {
+    case Attribute::None:
+        term::attribute_reset();
+        break;
+    case Attribute::Inverse:
+        term::attribute_inverse();
+        break;
+    }
+    output.attribute = attribute;
+}
+
+// Send the cells [first, last) of a row
+static void send_cells(
+    Output& output,
+    const Grid& grid,
+    size_t row,
+    size_t first,
+    size_t last)
+{
+    move_to(output, row, first);
+    const Cell* cells = row_cells(grid, row);
+    for (size_t col = first; col < last; col++) {
+        set_attribute(output, cells[col].attribute);
+        const auto& bytes = cells[col].bytes;
+        auto length = std::ranges::find(bytes, '\0') - bytes.begin();
+        editor::screen_buffer_append_n(
+            bytes.data(),
+            static_cast<size_t>(length));
+    }
+    output.col = last;
+    // The cursor stays on the last column until the next character wraps
+    if (last == grid.cols) {
+        output.position_known = false;
+    }
+}
+
+static void erase_to_end_of_row(Output& output, size_t row, size_t col)
+{
+    move_to(output, row, col);
+    // Erased cells take the current background color
+    set_attribute(output, Attribute::None);
+    term::erase_line();
+}
+
+static bool is_blank(const Cell& cell)
+{
+    return cell == Cell {};
+}
+
+static void present_row(
+    Output& output,
+    const Grid& front,
+    const Grid& back,
+    size_t row)
+{
+    size_t cols = back.cols;
+    const Cell* old_cells = row_cells(front, row);
+    const Cell* new_cells = row_cells(back, row);
+    if (std::equal(new_cells, new_cells + cols, old_cells)) {
+        return;
+    }
+
+    // Blank cells ending the row are erased at once
+    size_t blank_start = cols;
+    while (blank_start > 0 && is_blank(new_cells[blank_start - 1])) {
+        blank_start--;
+    }
+
+    size_t col = 0;
+    while (col < blank_start) {
+        if (old_cells[col] == new_cells[col]) {
+            col++;
+            continue;
+        }
+        // Extend the run over the next changed cells unless too far apart
+        size_t run_end = col + 1;
+        size_t gap = 0;
+        for (size_t next = run_end; next < blank_start; next++) {
+            if (old_cells[next] != new_cells[next]) {
+                run_end = next + 1;
+                gap = 0;
+            } else if (++gap > max_resent_gap) {
+                break;
+            }
+        }
+        send_cells(output, back, row, col, run_end);
+        col = run_end;
+    }
+    if (!std::all_of(old_cells + blank_start, old_cells + cols, is_blank)) {
+        erase_to_end_of_row(output, row, blank_start);
+    }
+}
+
+void present(Renderer& renderer)
+{
+    Output output;
+    if (!renderer.front_valid) {
+        term::attribute_reset();
+        term::clear(term::ClearMode::AllScreen);
+        reset(renderer.front, renderer.back.rows, renderer.back.cols);
+        renderer.front_valid = true;
+    }
+    for (size_t row = 0; row < renderer.back.rows; row++) {
+        present_row(output, renderer.front, renderer.back, row);
+    }
+    set_attribute(output, Attribute::None);
+    std::swap(renderer.front, renderer.back);
+}
+
+} // namespace ted::grid
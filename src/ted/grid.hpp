@@ -0,0 +1,91 @@
+#ifndef TED_GRID_HPP_
+#define TED_GRID_HPP_
+
+#include <ted/utils.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+namespace ted::grid {
+
+enum class Attribute : uint8_t {
+    None,
+    Inverse,
+};
+
+struct Cell {
+    // UTF-8 bytes of the character, the unused ones being zero
+    std::array<char, utils::max_char_length> bytes { ' ' };
+    Attribute attribute = Attribute::None;
+
+    bool operator==(const Cell&) const = default;
+};
+
+// Characters of the terminal screen, one character per cell
+struct Grid {
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<Cell> cells;
+};
+
+// Resize a grid and fill it with blank cells
+void reset(Grid& grid, size_t rows, size_t cols);
+
+// Write text from a position, one character per cell, clipped to the end of the
+// row. Control characters, tabs included, and invalid UTF-8 sequences are
+// replaced so that each cell takes exactly one column on the terminal. Return
+// the column following the text.
+size_t put(
+    Grid& grid,
+    size_t row,
+    size_t col,
+    std::string_view text,
+    Attribute attribute = Attribute::None);
+
+// Write part of a line as put() does, but with tabs expanded to the next
+// multiple of `tab_stop` columns from the start of the line, the text starting
+// at the display column `text_col` of the line. The display column `first_col`
+// of the line is written on the first column of the row, and the line is
+// clipped to the end of the row.
+void put_line(
+    Grid& grid,
+    size_t row,
+    std::string_view text,
+    size_t text_col,
+    size_t first_col,
+    size_t tab_stop);
+
+// Frames are drawn into the back grid, then only the differences with the
+// front grid, holding what the terminal currently shows, are sent
+struct Renderer {
+    Grid front;
+    Grid back;
+    // Whether the terminal is known to show the front grid
+    bool front_valid = false;
+};
+
+// Start a frame with a blank back grid of the given size. The whole screen is
+// repainted if the size changed since the last frame.
+void begin_frame(Renderer& renderer, size_t rows, size_t cols);
+
+// Send the escape sequences turning the front grid into the back grid to the
+// screen buffer, then make the back grid the front one
+void present(Renderer& renderer);
+
+// Have the terminal move the content of the rows [top, bottom) by `rows` rows,
+// up if positive and down if negative, so that only the rows it exposes differ
+// from the next frame if the content it shows moved by as much. To be called
+// before present(), does nothing if the screen is going to be repainted.
+void scroll(Renderer& renderer, size_t top, size_t bottom, std::ptrdiff_t rows);
+
+// Repaint the whole screen on the next frame, for instance when its content
+// was damaged by other means
+void invalidate(Renderer& renderer);
+
+} // namespace ted::grid
+
+#endif // TED_GRID_HPP_
@@ -1,7 +1,9 @@
 #ifndef TED_KEY_HPP_
 #define TED_KEY_HPP_
 
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
 
 namespace ted {
 
@@ -145,17 +147,107 @@ struct Key {
         Right,
         Home,
         Backspace,
+        // Function keys, space for 64, see function_key()
+        F0,
+        F1,
+        F2,
+        F3,
+        F4,
+        F5,
+        F6,
+        F7,
+        F8,
+        F9,
+        F10,
+        F11,
+        F12,
+
+        DeleteChar = 330,
+        Insert,
 
         PageDown = 338,
         PageUp,
 
+        BackTab = 353,
+
         End = 360,
 
+        // The values past the ncurses ones are specific to ted
+
+        // Keys combined with modifiers, see with_modifiers()
+        ModifiedKeys = 416,
+
+        // Events reported by the terminal
+        BracketedPaste = 496,
+
         Count = 512,
         //clang-format on
     };
+
+    // Modifier flags, encoded by xterm as 1 plus their sum in the sequences of
+    // the modified keys
+    enum Modifier : uint8_t {
+        Shift = 1,
+        Alt = 2,
+        Ctrl = 4,
+    };
+
+    static constexpr uint8_t modifier_combination_count = 8;
+};
+
+// Function key `n`, up to F63
+constexpr Key::Code function_key(unsigned n)
+{
+    return static_cast<Key::Code>(Key::Code::F0 + n);
+}
+
+// Keys having a code for each combination of modifiers, starting from
+// Key::ModifiedKeys
+inline constexpr Key::Code modifiable_keys[] {
+    Key::Code::Up,
+    Key::Code::Down,
+    Key::Code::Right,
+    Key::Code::Left,
+    Key::Code::Home,
+    Key::Code::End,
+    Key::Code::PageUp,
+    Key::Code::PageDown,
+    Key::Code::Insert,
+    Key::Code::DeleteChar,
 };
 
+// Code of a key combined with a set of modifiers. Modified function keys
+// follow the ncurses convention, Shift+F1 being F13, Ctrl+F1 F25, Ctrl+Shift+F1
+// F37, Alt+F1 F49 and Alt+Shift+F1 F61. Modifiers are dropped for the other
+// combinations and keys.
+constexpr Key::Code with_modifiers(Key::Code key, uint8_t modifiers)
+{
+    if (modifiers == 0 || modifiers >= Key::modifier_combination_count) {
+        return key;
+    }
+    for (size_t index = 0; index < std::size(modifiable_keys); index++) {
+        if (modifiable_keys[index] == key) {
+            return static_cast<Key::Code>(
+                Key::Code::ModifiedKeys
+                + ((modifiers - 1) * std::size(modifiable_keys)) + index);
+        }
+    }
+    if (Key::Code::F1 <= key && key <= Key::Code::F12) {
+        // Index of the group of 12 function keys for each set of modifiers
+        constexpr uint8_t groups[Key::modifier_combination_count] {
+            0, 1, 4, 5, 2, 3, 0, 0,
+        };
+        unsigned code = key + (groups[modifiers] * 12);
+        return code <= function_key(63) ? static_cast<Key::Code>(code) : key;
+    }
+    return key;
+}
+
+static_assert(
+    Key::Code::ModifiedKeys
+        + ((Key::modifier_combination_count - 1) * std::size(modifiable_keys))
+    <= Key::Code::BracketedPaste);
+
 } // namespace ted
 
 #if 0
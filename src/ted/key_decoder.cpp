@@ -0,0 +1,372 @@
+#include <ted/key_decoder.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+namespace ted::key_decoder {
+
+// Keys sent as "CSI <letter>" or "SS3 <letter>", and with modifiers as
+// "CSI 1 ; <modifiers> <letter>"
+struct LetterKey {
+    char letter;
+    Key::Code key;
+};
+
+static constexpr LetterKey letter_keys[] {
+    { 'A', Key::Code::Up },   { 'B', Key::Code::Down },
+    { 'C', Key::Code::Right }, { 'D', Key::Code::Left },
+    { 'H', Key::Code::Home }, { 'F', Key::Code::End },
+    { 'P', Key::Code::F1 },   { 'Q', Key::Code::F2 },
+    { 'R', Key::Code::F3 },   { 'S', Key::Code::F4 },
+};
+
+// Keys sent as "CSI <number> ~", and with modifiers as
+// "CSI <number> ; <modifiers> ~"
+struct NumberKey {
+    uint8_t number;
+    Key::Code key;
+};
+
+static constexpr NumberKey number_keys[] {
+    { 1, Key::Code::Home },        { 2, Key::Code::Insert },
+    { 3, Key::Code::DeleteChar },  { 4, Key::Code::End },
+    { 5, Key::Code::PageUp },      { 6, Key::Code::PageDown },
+    { 7, Key::Code::Home },        { 8, Key::Code::End },
+    { 11, Key::Code::F1 },         { 12, Key::Code::F2 },
+    { 13, Key::Code::F3 },         { 14, Key::Code::F4 },
+    { 15, Key::Code::F5 },         { 17, Key::Code::F6 },
+    { 18, Key::Code::F7 },         { 19, Key::Code::F8 },
+    { 20, Key::Code::F9 },         { 21, Key::Code::F10 },
+    { 23, Key::Code::F11 },        { 24, Key::Code::F12 },
+};
+
+// Longest sequence, "\e[24;8~"
+static constexpr size_t max_sequence_length = 8;
+
+// Sequence assembled at compile time
+struct Sequence {
+    char bytes[max_sequence_length] {};
+    size_t length = 0;
+
+    constexpr explicit Sequence(std::string_view prefix)
+    {
+        for (char c : prefix) {
+            append(c);
+        }
+    }
+
+    constexpr void append(char c)
+    {
+        bytes[length++] = c;
+    }
+
+    constexpr void append_number(unsigned number)
+    {
+        if (number >= 10) {
+            append_number(number / 10);
+        }
+        append(static_cast<char>('0' + (number % 10)));
+    }
+
+    [[nodiscard]]
+    constexpr std::string_view view() const
+    {
+        return std::string_view(bytes, length);
+    }
+};
+
+// Call `visitor` with each known sequence and its key
+template<class Visitor>
+static constexpr void for_each_sequence(Visitor&& visitor)
+{
+    for (const LetterKey& letter_key : letter_keys) {
+        for (std::string_view introducer : { "\e[", "\eO" }) {
+            Sequence sequence(introducer);
+            sequence.append(letter_key.letter);
+            visitor(sequence.view(), letter_key.key);
+        }
+        for (uint8_t modifiers = 1;
+             modifiers < Key::modifier_combination_count;
+             modifiers++) {
+            // The SS3 form is sent by older terminals
+            for (std::string_view introducer : { "\e[1;", "\eO" }) {
+                Sequence sequence(introducer);
+                sequence.append_number(modifiers + 1);
+                sequence.append(letter_key.letter);
+                visitor(
+                    sequence.view(),
+                    with_modifiers(letter_key.key, modifiers));
+            }
+        }
+    }
+    for (const NumberKey& number_key : number_keys) {
+        Sequence sequence("\e[");
+        sequence.append_number(number_key.number);
+        sequence.append('~');
+        visitor(sequence.view(), number_key.key);
+        for (uint8_t modifiers = 1;
+             modifiers < Key::modifier_combination_count;
+             modifiers++) {
+            Sequence modified("\e[");
+            modified.append_number(number_key.number);
+            modified.append(';');
+            modified.append_number(modifiers + 1);
+            modified.append('~');
+            visitor(
+                modified.view(),
+                with_modifiers(number_key.key, modifiers));
+        }
+    }
+    visitor("\e[Z", Key::Code::BackTab);
+    // F1 to F5 on the Linux console
+    for (unsigned index = 0; index < 5; index++) {
+        Sequence sequence("\e[[");
+        sequence.append(static_cast<char>('A' + index));
+        visitor(sequence.view(), function_key(1 + index));
+    }
+    visitor("\e[200~", Key::Code::BracketedPaste);
+}
+
+// The bytes found in the sequences each get a class, all the others sharing
+// class 0, so that the transition table only has a column per class
+static constexpr std::array<uint8_t, 256> byte_classes = [] {
+    std::array<uint8_t, 256> classes {};
+    uint8_t class_count = 1;
+    for_each_sequence([&](std::string_view sequence, Key::Code) {
+        for (char c : sequence) {
+            uint8_t& byte_class = classes[static_cast<unsigned char>(c)];
+            if (byte_class == 0) {
+                byte_class = class_count++;
+            }
+        }
+    });
+    return classes;
+}();
+
+static constexpr size_t class_count
+    = 1 + *std::ranges::max_element(byte_classes);
+
+using Parameters = Decoder::Parameters;
+
+// Add a byte to the parameters of a CSI sequence, return false if it is not a
+// parameter byte
+static constexpr bool parse_parameter(Parameters& parameters, char c)
+{
+    if ('0' <= c && c <= '9') {
+        if (parameters.index < std::size(parameters.values)
+            && !parameters.in_sub_parameter) {
+            uint32_t& value = parameters.values[parameters.index];
+            value = (value * 10) + static_cast<uint32_t>(c - '0');
+        }
+        return true;
+    }
+    if (c == ';') {
+        if (parameters.index < std::size(parameters.values)) {
+            parameters.index++;
+        }
+        parameters.in_sub_parameter = false;
+        return true;
+    }
+    if (c == ':') {
+        parameters.in_sub_parameter = true;
+        return true;
+    }
+    return false;
+}
+
+// Parameters of a trie state, for the states whose sequence is "CSI" followed
+// by parameter bytes only, from which a "CSI ... u" sequence may continue
+struct StateParameters {
+    bool in_parameters = false;
+    Parameters parameters;
+};
+
+static constexpr StateParameters get_state_parameters(std::string_view prefix)
+{
+    StateParameters state;
+    if (!prefix.starts_with("\e[")) {
+        return state;
+    }
+    for (char c : prefix.substr(2)) {
+        if (!parse_parameter(state.parameters, c)) {
+            return state;
+        }
+    }
+    state.in_parameters = true;
+    return state;
+}
+
+// Trie of the sequences, state 0 being the root. A transition to state 0
+// means that no sequence continues with the byte.
+struct Trie {
+    // `class_count` transitions per state
+    std::vector<uint16_t> transitions;
+    // Key of the sequence ending at each state, or Key::Code::Null
+    std::vector<Key::Code> keys;
+    std::vector<StateParameters> parameters;
+    // Whether each sequence ends at a leaf, which the decoder relies on to
+    // stop at the first complete sequence
+    bool prefix_free = true;
+};
+
+static constexpr Trie build_trie()
+{
+    Trie trie;
+    auto add_state = [&trie](std::string_view prefix) {
+        trie.transitions.resize(trie.transitions.size() + class_count, 0);
+        trie.keys.push_back(Key::Code::Null);
+        trie.parameters.push_back(get_state_parameters(prefix));
+        return static_cast<uint16_t>(trie.keys.size() - 1);
+    };
+    add_state({});
+    for_each_sequence([&](std::string_view sequence, Key::Code key) {
+        uint16_t state = 0;
+        for (size_t length = 1; length <= sequence.size(); length++) {
+            if (trie.keys[state] != Key::Code::Null) {
+                trie.prefix_free = false;
+            }
+            auto byte = static_cast<unsigned char>(sequence[length - 1]);
+            size_t transition = (state * class_count) + byte_classes[byte];
+            if (trie.transitions[transition] == 0) {
+                uint16_t next = add_state(sequence.substr(0, length));
+                trie.transitions[transition] = next;
+            }
+            state = trie.transitions[transition];
+        }
+        auto first = trie.transitions.begin()
+            + static_cast<std::ptrdiff_t>(state * class_count);
+        if (trie.keys[state] != Key::Code::Null
+            || std::any_of(first, first + class_count, [](uint16_t next) {
+                   return next != 0;
+               })) {
+            trie.prefix_free = false;
+        }
+        trie.keys[state] = key;
+    });
+    return trie;
+}
+
+static_assert(build_trie().prefix_free, "a sequence is a prefix of another");
+
+static constexpr size_t state_count = build_trie().keys.size();
+
+// Transitions ending a sequence hold the key of the sequence marked with this
+// flag instead of the next state, so that decoding a byte takes a single lookup
+static constexpr uint16_t complete_flag = 0x8000;
+static_assert(Key::Code::Count <= complete_flag && state_count < complete_flag);
+
+static constexpr auto transitions = [] {
+    Trie trie = build_trie();
+    std::array<uint16_t, state_count * class_count> table {};
+    for (size_t index = 0; index < table.size(); index++) {
+        uint16_t next = trie.transitions[index];
+        table[index] = trie.keys[next] != Key::Code::Null
+            ? complete_flag | trie.keys[next]
+            : next;
+    }
+    return table;
+}();
+
+static constexpr auto state_parameters = [] {
+    std::array<StateParameters, state_count> table {};
+    std::ranges::copy(build_trie().parameters, table.begin());
+    return table;
+}();
+
+// Key of a "CSI <code> ; <modifiers> u" sequence, the code being the one of the
+// key without modifiers and the modifiers being encoded as for xterm. Return
+// Key::Code::Null for the keys and modifiers having no equivalent.
+static Key::Code kitty_key(const Parameters& parameters)
+{
+    // Caps Lock and Num Lock are reported in the bits following Super, Hyper
+    // and Meta, which are not supported
+    static constexpr uint32_t lock_modifiers = 64 | 128;
+    static constexpr uint32_t unsupported_modifiers = 8 | 16 | 32;
+
+    uint32_t code = parameters.values[0];
+    uint32_t modifiers
+        = parameters.values[1] > 0 ? parameters.values[1] - 1 : 0;
+    modifiers &= ~lock_modifiers;
+    // Functional keys other than the ASCII ones are in the private use area
+    if (code == 0 || code >= 0x80 || (modifiers & unsupported_modifiers) != 0) {
+        return Key::Code::Null;
+    }
+    if (modifiers == 0) {
+        return static_cast<Key::Code>(code);
+    }
+    if (modifiers == Key::Shift) {
+        if (code == '\t') {
+            return Key::Code::BackTab;
+        }
+        if ('a' <= code && code <= 'z') {
+            return static_cast<Key::Code>(code - 'a' + 'A');
+        }
+        return static_cast<Key::Code>(code);
+    }
+    if ((modifiers & ~Key::Shift) == Key::Ctrl && '@' <= (code & ~0x20U)
+        && (code & ~0x20U) <= '_') {
+        return static_cast<Key::Code>(code & 0x1f);
+    }
+    return Key::Code::Null;
+}
+
+// Continue parsing the parameters of a CSI sequence unknown to the trie from
+// `bytes[index]`
+static Result decode_parameters(
+    Decoder& decoder,
+    std::string_view bytes,
+    size_t index)
+{
+    decoder.in_parameters = true;
+    for (; index < bytes.size(); index++) {
+        if (parse_parameter(decoder.parameters, bytes[index])) {
+            continue;
+        }
+        Parameters parameters = decoder.parameters;
+        decoder = {};
+        if (bytes[index] == 'u') {
+            return Result {
+                Status::Complete,
+                kitty_key(parameters),
+                index + 1,
+            };
+        }
+        return Result { Status::Invalid, Key::Code::Null, index + 1 };
+    }
+    return Result { Status::Incomplete, Key::Code::Null, bytes.size() };
+}
+
+Result decode(Decoder& decoder, std::string_view bytes)
+{
+    if (decoder.in_parameters) {
+        return decode_parameters(decoder, bytes, 0);
+    }
+    uint16_t state = decoder.state;
+    for (size_t index = 0; index < bytes.size(); index++) {
+        auto byte = static_cast<unsigned char>(bytes[index]);
+        uint16_t next
+            = transitions[(state * class_count) + byte_classes[byte]];
+        if (next == 0) {
+            decoder.state = 0;
+            if (state_parameters[state].in_parameters) {
+                decoder.parameters = state_parameters[state].parameters;
+                return decode_parameters(decoder, bytes, index);
+            }
+            return Result { Status::Invalid, Key::Code::Null, index + 1 };
+        }
+        if ((next & complete_flag) != 0) {
+            decoder.state = 0;
+            auto key = static_cast<Key::Code>(next & ~complete_flag);
+            return Result { Status::Complete, key, index + 1 };
+        }
+        state = next;
+    }
+    decoder.state = state;
+    return Result { Status::Incomplete, Key::Code::Null, bytes.size() };
+}
+
+} // namespace ted::key_decoder
@@ -0,0 +1,59 @@
+#ifndef TED_KEY_DECODER_HPP_
+#define TED_KEY_DECODER_HPP_
+
+#include <ted/key.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+namespace ted::key_decoder {
+
+// Decoder of the escape sequences sent by terminals for the keys outside of
+// the ASCII range: cursor and editing keys, function keys, their xterm
+// modified variants such as "\e[1;5A", and the SS3 variants sent in
+// application mode. The sequences are matched against a trie generated at
+// compile time, taking one table lookup per byte.
+// CSI sequences unknown to the trie are parsed as "CSI <code> ; <modifiers> u",
+// the form used by the kitty keyboard protocol for the keys it disambiguates.
+// The decoder keeps its position in the trie or the parameters parsed so far,
+// so that a sequence can be decoded from several chunks of input.
+struct Decoder {
+    // First two parameters of a CSI sequence, without their sub-parameters
+    struct Parameters {
+        uint32_t values[2] {};
+        uint8_t index = 0;
+        bool in_sub_parameter = false;
+    };
+
+    uint16_t state = 0;
+    bool in_parameters = false;
+    Parameters parameters;
+};
+
+enum class Status : uint8_t {
+    // A sequence was decoded
+    Complete,
+    // The bytes are the start of a sequence, more are needed
+    Incomplete,
+    // The bytes are not the start of any known sequence
+    Invalid,
+};
+
+struct Result {
+    Status status;
+    Key::Code key;
+    // Bytes consumed from the input: up to the end of the sequence if
+    // complete, including the first unexpected byte if invalid. The CSI
+    // sequences with unknown parameters are consumed up to their final byte.
+    size_t length;
+};
+
+// Continue decoding a sequence, starting with the escape byte, with the next
+// bytes of input. The decoder is reset once a sequence is complete or invalid.
+[[nodiscard]]
+Result decode(Decoder& decoder, std::string_view bytes);
+
+} // namespace ted::key_decoder
+
+#endif // TED_KEY_DECODER_HPP_
@@ -0,0 +1,437 @@
+#include <ted/line_index.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__))                                \
+    && (defined(__GNUC__) || defined(__clang__))
+#define TED_LINE_INDEX_X86 1
+#include <immintrin.h>
+#else
+#define TED_LINE_INDEX_X86 0
+#endif
+
+namespace ted::line_index {
+
+using FindNewlines = void(
+    const char* text,
+    size_t length,
+    uint64_t base_offset,
+    Offsets& newlines);
+
+static void find_newlines_scalar(
+    const char* text,
+    size_t length,
+    uint64_t base_offset,
+    Offsets& newlines)
+{
+    const char* end = text + length;
+    for (const char* it = text; it < end; it++) {
+        it = static_cast<const char*>(std::memchr(it, '\n', end - it));
+        if (it == nullptr) {
+            break;
+        }
+        newlines.push_back(base_offset + (it - text));
+    }
+}
+
+// Push the offsets of the bits set in a comparison mask of a block of text
+// starting at `block_offset`
+template<class Mask>
+static void push_mask(
+    Mask mask,
+    uint64_t block_offset,
+    Offsets& newlines)
+{
+    while (mask != 0) {
+        newlines.push_back(block_offset + std::countr_zero(mask));
+        mask &= mask - 1;
+    }
+}
+
+#if TED_LINE_INDEX_X86
+
+__attribute__((target("sse2"))) static void find_newlines_sse2(
+    const char* text,
+    size_t length,
+    uint64_t base_offset,
+    Offsets& newlines)
+{
+    static constexpr size_t block_size = sizeof(__m128i);
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t offset = 0;
+    for (; offset + block_size <= length; offset += block_size) {
+        __m128i block = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(text + offset));
+        auto mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        push_mask(mask, base_offset + offset, newlines);
+    }
+    find_newlines_scalar(
+        text + offset,
+        length - offset,
+        base_offset + offset,
+        newlines);
+}
+
+__attribute__((target("avx2"))) static void find_newlines_avx2(
+    const char* text,
+    size_t length,
+    uint64_t base_offset,
+    Offsets& newlines)
+{
+    // Two vectors per iteration so that the mask covers 64 bytes
+    static constexpr size_t block_size = 2 * sizeof(__m256i);
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t offset = 0;
+    for (; offset + block_size <= length; offset += block_size) {
+        __m256i low = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(text + offset));
+        __m256i high = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(text + offset + sizeof(__m256i)));
+        auto low_mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline)));
+        auto high_mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline)));
+        uint64_t mask = (uint64_t { high_mask } << 32U) | low_mask;
+        push_mask(mask, base_offset + offset, newlines);
+    }
+    find_newlines_sse2(
+        text + offset,
+        length - offset,
+        base_offset + offset,
+        newlines);
+}
+
+static FindNewlines* select_find_newlines()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return find_newlines_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return find_newlines_sse2;
+    }
+    return find_newlines_scalar;
+}
+
+#else
+
+static FindNewlines* select_find_newlines()
+{
+    return find_newlines_scalar;
+}
+
+#endif
+
+void find_newlines(
+    std::string_view text,
+    uint64_t base_offset,
+    Offsets& newlines)
+{
+    static FindNewlines* const find_newlines_impl = select_find_newlines();
+    find_newlines_impl(text.data(), text.size(), base_offset, newlines);
+}
+
+// Size of the blocks indexed before looking at the number of newlines found
+static constexpr size_t sample_size = size_t { 64 } * 1024;
+
+// Size of the blocks scanned before compacting their newline offsets
+static constexpr size_t scan_block_size = size_t { 1024 } * 1024;
+
+// Size of the blocks indexed in the background before publishing them
+static constexpr size_t background_block_size = size_t { 4 } * 1024 * 1024;
+
+static size_t table_size(const NewlineTable& table)
+{
+    return table.is_wide ? table.wide.size() : table.deltas.size();
+}
+
+static uint64_t table_at(const NewlineTable& table, size_t n)
+{
+    if (table.is_wide) {
+        return table.wide[n];
+    }
+    return table.block_bases[n / newline_block_size] + table.deltas[n];
+}
+
+static void widen(NewlineTable& table)
+{
+    Offsets wide;
+    wide.reserve(table.deltas.capacity());
+    for (size_t n = 0; n < table.deltas.size(); n++) {
+        wide.push_back(table_at(table, n));
+    }
+    table.wide = std::move(wide);
+    table.block_bases = {};
+    table.deltas = {};
+    table.is_wide = true;
+}
+
+static void table_append(NewlineTable& table, const Offsets& offsets)
+{
+    for (uint64_t offset : offsets) {
+        if (table.is_wide) {
+            table.wide.push_back(offset);
+            continue;
+        }
+        if (table.deltas.size() % newline_block_size == 0) {
+            table.block_bases.push_back(offset);
+            table.deltas.push_back(0);
+            continue;
+        }
+        uint64_t delta = offset - table.block_bases.back();
+        if (delta > std::numeric_limits<uint32_t>::max()) {
+            widen(table);
+            table.wide.push_back(offset);
+            continue;
+        }
+        table.deltas.push_back(static_cast<uint32_t>(delta));
+    }
+}
+
+// Number of newlines located strictly before `offset`
+static size_t table_lower_bound(const NewlineTable& table, uint64_t offset)
+{
+    if (table.is_wide) {
+        return std::ranges::lower_bound(table.wide, offset)
+            - table.wide.begin();
+    }
+    // Look for the newline in the last block starting before the offset
+    auto block = std::ranges::lower_bound(table.block_bases, offset);
+    if (block == table.block_bases.begin()) {
+        return 0;
+    }
+    --block;
+    size_t first = (block - table.block_bases.begin()) * newline_block_size;
+    size_t last = std::min(first + newline_block_size, table.deltas.size());
+    uint64_t delta = offset - *block;
+    if (delta > std::numeric_limits<uint32_t>::max()) {
+        return last;
+    }
+    const uint32_t* deltas = table.deltas.data();
+    return std::lower_bound(
+               deltas + first,
+               deltas + last,
+               static_cast<uint32_t>(delta))
+        - deltas;
+}
+
+// Index the newlines of a text starting at `base_offset` into a table
+static void index_text(
+    NewlineTable& table,
+    std::string_view text,
+    uint64_t base_offset,
+    Offsets& scratch)
+{
+    for (size_t offset = 0; offset < text.size(); offset += scan_block_size) {
+        scratch.clear();
+        find_newlines(
+            text.substr(offset, scan_block_size),
+            base_offset + offset,
+            scratch);
+        table_append(table, scratch);
+    }
+}
+
+// Growing the table dominates the scan itself, so reserve it from the line
+// density of the part of the text already indexed
+static void reserve_estimate(
+    NewlineTable& table,
+    size_t indexed_bytes,
+    size_t text_size)
+{
+    if (indexed_bytes == 0 || indexed_bytes >= text_size || table.is_wide) {
+        return;
+    }
+    size_t estimate = text_size / indexed_bytes * (table.deltas.size() + 1);
+    estimate += estimate / 8;
+    table.deltas.reserve(estimate);
+    table.block_bases.reserve((estimate / newline_block_size) + 1);
+}
+
+// Give back the excess when the estimate was far off
+template<class Vector>
+static void shrink_excess(Vector& vector)
+{
+    if (vector.capacity() - vector.size() > vector.size() / 4) {
+        vector.shrink_to_fit();
+    }
+}
+
+static void shrink_excess(NewlineTable& table)
+{
+    shrink_excess(table.block_bases);
+    shrink_excess(table.deltas);
+    shrink_excess(table.wide);
+}
+
+void build(LineIndex& index, std::string_view text)
+{
+    index.background.reset();
+    index.newlines = {};
+
+    Offsets scratch;
+    std::string_view sample = text.substr(0, sample_size);
+    index_text(index.newlines, sample, 0, scratch);
+    if (sample.size() < text.size()) {
+        reserve_estimate(index.newlines, sample.size(), text.size());
+        index_text(
+            index.newlines,
+            text.substr(sample.size()),
+            sample.size(),
+            scratch);
+    }
+    shrink_excess(index.newlines);
+}
+
+static void index_in_background(
+    BackgroundIndexing& background,
+    std::string_view text,
+    size_t offset,
+    const std::stop_token& stop_token)
+{
+    Offsets block_newlines;
+    while (offset < text.size() && !stop_token.stop_requested()) {
+        std::string_view block = text.substr(offset, background_block_size);
+        block_newlines.clear();
+        find_newlines(block, offset, block_newlines);
+        offset += block.size();
+        {
+            std::scoped_lock lock(background.mutex);
+            table_append(background.newlines, block_newlines);
+            background.indexed_bytes = offset;
+            background.complete = offset == text.size();
+        }
+        background.progress.notify_all();
+    }
+}
+
+void build_progressive(
+    LineIndex& index,
+    std::string_view text,
+    size_t min_newlines)
+{
+    index.background.reset();
+    index.newlines = {};
+
+    Offsets scratch;
+    size_t offset = 0;
+    while (offset < text.size()
+           && table_size(index.newlines) < min_newlines) {
+        std::string_view block = text.substr(offset, sample_size);
+        index_text(index.newlines, block, offset, scratch);
+        offset += block.size();
+    }
+    if (offset == text.size()) {
+        shrink_excess(index.newlines);
+        return;
+    }
+
+    auto background = std::make_unique<BackgroundIndexing>();
+    background->newlines = std::move(index.newlines);
+    reserve_estimate(background->newlines, offset, text.size());
+    background->indexed_bytes = offset;
+    background->text_size = text.size();
+    background->thread = std::jthread(
+        [&shared = *background, text, offset](std::stop_token stop_token) {
+            index_in_background(shared, text, offset, stop_token);
+        });
+    index.background = std::move(background);
+}
+
+// Lock the background indexing state once it is complete or `ready` is true
+template<class Ready>
+static std::unique_lock<std::mutex> wait_until(
+    BackgroundIndexing& background,
+    Ready ready)
+{
+    std::unique_lock lock(background.mutex);
+    background.progress.wait(
+        lock,
+        [&] { return background.complete || ready(); });
+    return lock;
+}
+
+bool is_complete(const LineIndex& index)
+{
+    if (!index.background) {
+        return true;
+    }
+    std::scoped_lock lock(index.background->mutex);
+    return index.background->complete;
+}
+
+unsigned progress(const LineIndex& index)
+{
+    if (!index.background) {
+        return 100;
+    }
+    BackgroundIndexing& background = *index.background;
+    std::scoped_lock lock(background.mutex);
+    return static_cast<unsigned>(
+        background.indexed_bytes * 100 / background.text_size);
+}
+
+void finish(LineIndex& index)
+{
+    if (!index.background) {
+        return;
+    }
+    BackgroundIndexing& background = *index.background;
+    wait_until(background, [] { return false; }).unlock();
+    background.thread.join();
+    index.newlines = std::move(background.newlines);
+    index.background.reset();
+    shrink_excess(index.newlines);
+}
+
+size_t newline_count(const LineIndex& index)
+{
+    if (index.background) {
+        BackgroundIndexing& background = *index.background;
+        auto lock = wait_until(background, [] { return false; });
+        return table_size(background.newlines);
+    }
+    return table_size(index.newlines);
+}
+
+bool has_newline(const LineIndex& index, size_t n)
+{
+    if (index.background) {
+        BackgroundIndexing& background = *index.background;
+        auto lock = wait_until(
+            background,
+            [&] { return table_size(background.newlines) > n; });
+        return table_size(background.newlines) > n;
+    }
+    return table_size(index.newlines) > n;
+}
+
+uint64_t newline_offset(const LineIndex& index, size_t n)
+{
+    if (index.background) {
+        BackgroundIndexing& background = *index.background;
+        auto lock = wait_until(
+            background,
+            [&] { return table_size(background.newlines) > n; });
+        return table_at(background.newlines, n);
+    }
+    return table_at(index.newlines, n);
+}
+
+size_t newlines_before(const LineIndex& index, uint64_t offset)
+{
+    if (index.background) {
+        BackgroundIndexing& background = *index.background;
+        auto lock = wait_until(
+            background,
+            [&] { return background.indexed_bytes >= offset; });
+        return table_lower_bound(background.newlines, offset);
+    }
+    return table_lower_bound(index.newlines, offset);
+}
+
+} // namespace ted::line_index
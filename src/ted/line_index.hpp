@@ -0,0 +1,104 @@
+#ifndef TED_LINE_INDEX_HPP_
+#define TED_LINE_INDEX_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace ted::line_index {
+
+using Offsets = std::pmr::vector<uint64_t>;
+
+// Number of newlines sharing the same base offset in a NewlineTable
+inline constexpr size_t newline_block_size = 256;
+
+// Offsets of the newlines of a text stored in about 4 bytes each: the newlines
+// are grouped in blocks of `newline_block_size`, each block storing the offset
+// of its first newline, and each newline its distance to it in 32 bits.
+// Blocks spanning 4 GiB or more, only possible with huge lines, make the whole
+// table fall back to plain 64-bit offsets.
+struct NewlineTable {
+    std::vector<uint64_t> block_bases;
+    std::vector<uint32_t> deltas;
+    Offsets wide;
+    bool is_wide = false;
+};
+
+// State shared with the thread indexing the remainder of a text
+struct BackgroundIndexing {
+    std::mutex mutex;
+    std::condition_variable progress;
+    NewlineTable newlines;
+    size_t indexed_bytes = 0;
+    size_t text_size = 0;
+    bool complete = false;
+    // Last member so that it is joined before the rest is destroyed
+    std::jthread thread;
+};
+
+// Offsets of the newline characters of a text, in increasing order.
+// The line following the n-th newline starts one byte after it.
+// While a text is indexed in the background the offsets found so far live in
+// `background`, and are moved to `newlines` by finish() once complete.
+struct LineIndex {
+    NewlineTable newlines;
+    std::unique_ptr<BackgroundIndexing> background;
+};
+
+// Index all the newlines of a text
+void build(LineIndex& index, std::string_view text);
+
+// Index the beginning of a text until at least `min_newlines` newlines are
+// found, then index the rest in a background thread. The text must outlive the
+// indexing.
+void build_progressive(
+    LineIndex& index,
+    std::string_view text,
+    size_t min_newlines);
+
+// Whether the whole text is indexed, in which case finish() does not block
+[[nodiscard]]
+bool is_complete(const LineIndex& index);
+
+// Percentage of the text indexed so far
+[[nodiscard]]
+unsigned progress(const LineIndex& index);
+
+// Wait for the background indexing to complete, if any, and release it
+void finish(LineIndex& index);
+
+// The functions below block until the background indexing, if any, reached
+// the part of the text they need
+
+[[nodiscard]]
+size_t newline_count(const LineIndex& index);
+
+// Whether the text has at least n + 1 newlines
+[[nodiscard]]
+bool has_newline(const LineIndex& index, size_t n);
+
+// Offset of the n-th newline, starting from 0
+[[nodiscard]]
+uint64_t newline_offset(const LineIndex& index, size_t n);
+
+// Number of newlines located strictly before `offset`
+[[nodiscard]]
+size_t newlines_before(const LineIndex& index, uint64_t offset);
+
+// Append the offsets of the newlines of `text`, shifted by `base_offset`.
+// The text is scanned with the widest vector instructions supported by the
+// CPU, selected at runtime, with a scalar fallback.
+void find_newlines(
+    std::string_view text,
+    uint64_t base_offset,
+    Offsets& newlines);
+
+} // namespace ted::line_index
+
+#endif // TED_LINE_INDEX_HPP_
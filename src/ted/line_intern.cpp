@@ -0,0 +1,67 @@
+#include <ted/line_intern.hpp>
+
+#include <unordered_map>
+
+namespace ted::line_intern {
+
+using piece_table::Piece;
+using piece_table::Source;
+
+InternedText intern(std::string_view text)
+{
+    InternedText interned;
+    // Offset in the interned text of the first occurrence of each line. The
+    // lines are views of `text`, including their newline character.
+    std::unordered_map<std::string_view, size_t> line_starts;
+
+    auto append = [&](size_t start, std::string_view line) {
+        size_t newlines = line.ends_with('\n') ? 1 : 0;
+        if (!interned.pieces.empty()) {
+            Piece& last = interned.pieces.back();
+            if (last.start + last.length == start) {
+                last.length += line.size();
+                last.newline_count += newlines;
+                return;
+            }
+        }
+        interned.pieces.push_back(Piece {
+            .source = Source::Original,
+            .start = start,
+            .length = line.size(),
+            .newline_count = newlines,
+        });
+    };
+    auto extends_last_piece = [&](size_t start) {
+        const Piece& last = interned.pieces.back();
+        return last.start + last.length == start;
+    };
+
+    size_t line_start = 0;
+    while (line_start < text.size()) {
+        size_t newline = text.find('\n', line_start);
+        size_t line_end = newline == std::string_view::npos ? text.size()
+                                                            : newline + 1;
+        std::string_view line = text.substr(line_start, line_end - line_start);
+        line_start = line_end;
+        interned.line_count++;
+
+        auto [found, is_new] = line_starts.try_emplace(line, 0);
+        if (!is_new
+            && (line.size() >= sizeof(Piece)
+                || extends_last_piece(found->second)
+                || !extends_last_piece(interned.text.size()))) {
+            append(found->second, line);
+            continue;
+        }
+        if (is_new) {
+            found->second = interned.text.size();
+        }
+        append(interned.text.size(), line);
+        interned.text.insert(interned.text.end(), line.begin(), line.end());
+    }
+    interned.distinct_line_count = line_starts.size();
+    interned.text.shrink_to_fit();
+    return interned;
+}
+
+} // namespace ted::line_intern
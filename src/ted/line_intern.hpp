@@ -0,0 +1,32 @@
+#ifndef TED_LINE_INTERN_HPP_
+#define TED_LINE_INTERN_HPP_
+
+#include <ted/piece_table.hpp>
+
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+namespace ted::line_intern {
+
+// Text holding each distinct line of another text once, and the pieces of it
+// assembling the other text, to be used as the original buffer of a piece
+// table. Lines which are new or which follow each other as in the interned text
+// extend the same piece, so that only the repeated lines cost a piece.
+struct InternedText {
+    std::vector<char> text;
+    std::vector<piece_table::Piece> pieces;
+    // Lines of the other text, the last one counting only if it is not empty
+    size_t line_count = 0;
+    size_t distinct_line_count = 0;
+};
+
+// Hash the lines of a text to keep each distinct line once. Repeated lines
+// shorter than a piece are copied again rather than referenced when that
+// extends the last piece, as referencing them would take more memory.
+[[nodiscard]]
+InternedText intern(std::string_view text);
+
+} // namespace ted::line_intern
+
+#endif // TED_LINE_INTERN_HPP_
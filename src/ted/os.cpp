@@ -7,6 +7,8 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <mutex>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -34,6 +36,12 @@ struct AtExitRegisterer {
     }
 };
 
+// Debug messages printed by a ring 0 exit handler, so defined before
+// `at_exit_registerer` for the same reason as `at_exit_registry`
+static std::atomic_bool debug_log_enabled = false;
+static std::mutex debug_log_mutex;
+static std::vector<std::string> debug_log_messages;
+
 // The definition order here matters
 // First define `at_exit_registry` holding the list of handlers
 // Then define `at_exit_registerer` registering the std::atexit handler
@@ -104,6 +112,40 @@ static void print_source_location(std::source_location source_location)
         source_location.line());
 }
 
+static void print_debug_log()
+{
+    std::scoped_lock lock(debug_log_mutex);
+    for (const std::string& message : debug_log_messages) {
+        (void)std::fprintf(stderr, "%s\n", message.c_str());
+    }
+}
+
+void enable_debug_log(bool do_enable_debug_log)
+{
+    // Registered once from the calling thread, as the exit handlers are not
+    // protected against concurrent registrations
+    static bool print_registered = false;
+    if (do_enable_debug_log && !print_registered) {
+        at_exit_ring0(print_debug_log);
+        print_registered = true;
+    }
+    debug_log_enabled = do_enable_debug_log;
+}
+
+bool is_debug_log_enabled()
+{
+    return debug_log_enabled;
+}
+
+void debug_log(std::string message)
+{
+    if (!debug_log_enabled) {
+        return;
+    }
+    std::scoped_lock lock(debug_log_mutex);
+    debug_log_messages.push_back(std::move(message));
+}
+
 void exit_ok(std::source_location srcloc)
 {
     if (must_print_source_location) {
@@ -3,10 +3,15 @@
 
 #include <ted/utils.hpp>
 
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <format>
 #include <source_location>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace ted::os {
 
@@ -58,9 +63,126 @@ void exit_err_format(utils::Fmt fmt, Args&&... args)
 // Prepend the source location before the exit message
 void print_source_location_at_exit(bool do_print_source_location);
 
+// Debug messages are kept until the program terminates and printed into stderr
+// afterwards, as the TUI hides it in the meantime. They are dropped unless
+// enabled. Can be called from any thread.
+void enable_debug_log(bool do_enable_debug_log);
+[[nodiscard]]
+bool is_debug_log_enabled();
+void debug_log(std::string message);
+
+template<class... Args>
+void debug_log_format(std::format_string<Args...> fmt, Args&&... args)
+{
+    if (is_debug_log_enabled()) {
+        debug_log(std::format(fmt, std::forward<Args>(args)...));
+    }
+}
+
 [[nodiscard]]
 bool isatty(FILE* stream);
 
+// Read-only view of a whole file mapped in memory, unmapped on destruction
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    // Kept open so that ranges of the file as mapped can be copied from it,
+    // even once the file is replaced
+    int fd = -1;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+};
+
+// Map a regular file in memory. Return false if the file cannot be opened or
+// is not a regular file, in which case it must be read by other means.
+[[nodiscard]]
+bool map_file(const char* path, MappedFile& mapped_file);
+
+enum class Advice : uint8_t {
+    Normal,
+    Sequential,
+    WillNeed,
+};
+
+// Hint the system about how a range of a mapped file is going to be accessed
+void advise(
+    const MappedFile& mapped_file,
+    size_t offset,
+    size_t length,
+    Advice advice);
+
+// Whether `path` still is the mapped file, and not a file replacing it
+[[nodiscard]]
+bool is_same_file(const MappedFile& mapped_file, const char* path);
+
+// Give the pages of a range of a mapped file their own copy in memory, so
+// that they keep their content when the file is written afterwards. The
+// mapping can be read by other threads meanwhile. Return false with errno set
+// on failure.
+[[nodiscard]]
+bool privatize(const MappedFile& mapped_file, size_t offset, size_t length);
+
+// New content of a file, written to a temporary file in the same directory and
+// renamed over the file once complete, so that the file is never seen half
+// written even if the program is killed meanwhile. The temporary file is
+// removed on destruction unless committed.
+struct FileWriter {
+    int fd = -1;
+    // Path of the file replaced, symbolic links resolved
+    std::string path;
+    std::string temp_path;
+    // Spans queued by write(), written at once by a single system call
+    std::vector<std::string_view> queued;
+    size_t queued_size = 0;
+
+    FileWriter() = default;
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+    ~FileWriter();
+};
+
+// Create the temporary file for a new content of `path`, with the permissions
+// of the file if it exists. Return false with errno set on failure, as do the
+// following functions.
+[[nodiscard]]
+bool open_writer(FileWriter& writer, const char* path);
+
+// Append a span to the content. The span is queued and must stay valid until
+// the writer is committed. The queued spans are written once a few megabytes
+// are queued, so that the content is written progressively.
+[[nodiscard]]
+bool write(FileWriter& writer, std::string_view span);
+
+// Append a range of a mapped file, copied by the file system without going
+// through memory where supported, sharing the blocks of both files if the file
+// system supports it. The range is read from the mapping otherwise.
+[[nodiscard]]
+bool copy_range(
+    FileWriter& writer,
+    const MappedFile& source,
+    size_t offset,
+    size_t length);
+
+// Open an existing file to overwrite ranges of it in place rather than writing
+// a new content, its size being unchanged. Unlike a new content, the file is
+// left partly updated if the program is killed while writing.
+[[nodiscard]]
+bool open_in_place(FileWriter& writer, const char* path);
+
+// Overwrite a range of a file opened in place
+[[nodiscard]]
+bool write_at(FileWriter& writer, size_t offset, std::string_view text);
+
+// Flush the content to the disk and replace the file with it, or only flush
+// the file if written in place
+[[nodiscard]]
+bool commit(FileWriter& writer);
+
 } // namespace ted::os
 
 #endif // TED_OS_HPP_
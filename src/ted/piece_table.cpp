@@ -0,0 +1,531 @@
+#include <ted/piece_table.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <utility>
+
+namespace ted::piece_table {
+
+// Index in the source newline table of the first newline at or after `start`
+static size_t first_newline_index(
+    const PieceTable& table,
+    Source source,
+    size_t start)
+{
+    if (source == Source::Original) {
+        return line_index::newlines_before(table.original_lines, start);
+    }
+    const auto& newlines = table.add_newlines;
+    return std::ranges::lower_bound(newlines, start) - newlines.begin();
+}
+
+static size_t newline_offset(const PieceTable& table, Source source, size_t n)
+{
+    if (source == Source::Original) {
+        return line_index::newline_offset(table.original_lines, n);
+    }
+    return table.add_newlines[n];
+}
+
+static size_t count_newlines(
+    const PieceTable& table,
+    Source source,
+    size_t start,
+    size_t length)
+{
+    return first_newline_index(table, source, start + length)
+        - first_newline_index(table, source, start);
+}
+
+static Piece make_piece(
+    const PieceTable& table,
+    Source source,
+    size_t start,
+    size_t length)
+{
+    return Piece {
+        .source = source,
+        .start = start,
+        .length = length,
+        .newline_count = count_newlines(table, source, start, length),
+    };
+}
+
+btree::Summary Traits::summarize(std::span<const Piece> pieces)
+{
+    btree::Summary summary {};
+    for (const Piece& piece : pieces) {
+        summary.bytes += piece.length;
+        summary.newlines += piece.newline_count;
+    }
+    return summary;
+}
+
+static void free_chunks(
+    std::pmr::memory_resource* resource,
+    std::pmr::vector<AddChunk>& chunks)
+{
+    for (const AddChunk& chunk : chunks) {
+        resource->deallocate(chunk.data, chunk.capacity, 1);
+    }
+    chunks.clear();
+}
+
+PieceTable::PieceTable(std::pmr::memory_resource* resource)
+    : add_chunks(resource)
+    , add_newlines(resource)
+    , pieces(resource)
+    , resource(resource)
+{
+}
+
+PieceTable::PieceTable(PieceTable&& other) noexcept
+    : original(std::exchange(other.original, {}))
+    , original_lines(std::move(other.original_lines))
+    , add_chunks(std::move(other.add_chunks))
+    , add_end(std::exchange(other.add_end, 0))
+    , add_newlines(std::move(other.add_newlines))
+    , pieces(std::move(other.pieces))
+    , resource(other.resource)
+{
+}
+
+PieceTable& PieceTable::operator=(PieceTable&& other) noexcept
+{
+    if (this != &other) {
+        free_chunks(resource, add_chunks);
+        original = std::exchange(other.original, {});
+        original_lines = std::move(other.original_lines);
+        add_chunks = std::move(other.add_chunks);
+        other.add_chunks.clear();
+        add_end = std::exchange(other.add_end, 0);
+        add_newlines = std::move(other.add_newlines);
+        pieces = std::move(other.pieces);
+        resource = other.resource;
+    }
+    return *this;
+}
+
+PieceTable::~PieceTable()
+{
+    free_chunks(resource, add_chunks);
+}
+
+void release(PieceTable& table)
+{
+    btree::release(table.pieces);
+    table.add_chunks.clear();
+    table.add_end = 0;
+}
+
+// Set the table to a single piece covering the whole original buffer, whose
+// newline count is only known once the original buffer is fully indexed
+static void reset_pieces(PieceTable& table, std::string_view original)
+{
+    table.original = original;
+    free_chunks(table.resource, table.add_chunks);
+    table.add_end = 0;
+    table.add_newlines.clear();
+    Piece piece {
+        .source = Source::Original,
+        .start = 0,
+        .length = table.original.size(),
+        .newline_count = 0,
+    };
+    btree::assign(
+        table.pieces,
+        std::span<const Piece>(&piece, original.empty() ? 0 : 1));
+}
+
+// Nothing can be edited before the original buffer is indexed, so the table is
+// still made of a single leaf holding the original piece
+static void set_original_newline_count(PieceTable& table)
+{
+    size_t newline_count = line_index::newline_count(table.original_lines);
+    btree::make_unique<Traits>(table.pieces.resource, table.pieces.root);
+    auto* leaf = static_cast<Leaf*>(table.pieces.root);
+    if (leaf->count > 0) {
+        leaf->items[0].newline_count = newline_count;
+    }
+    table.pieces.summary.newlines = newline_count;
+}
+
+void init(PieceTable& table, std::string_view original)
+{
+    reset_pieces(table, original);
+    line_index::build(table.original_lines, table.original);
+    set_original_newline_count(table);
+}
+
+void init(
+    PieceTable& table,
+    std::string_view original,
+    std::span<const Piece> pieces)
+{
+    reset_pieces(table, original);
+    line_index::build(table.original_lines, table.original);
+    btree::assign(table.pieces, pieces);
+}
+
+void init_progressive(
+    PieceTable& table,
+    std::string_view original,
+    size_t min_lines)
+{
+    reset_pieces(table, original);
+    line_index::build_progressive(
+        table.original_lines,
+        table.original,
+        min_lines);
+}
+
+bool is_indexing(const PieceTable& table)
+{
+    return table.original_lines.background != nullptr;
+}
+
+unsigned indexing_progress(const PieceTable& table)
+{
+    return line_index::progress(table.original_lines);
+}
+
+void finish_indexing(PieceTable& table)
+{
+    if (!is_indexing(table)) {
+        return;
+    }
+    line_index::finish(table.original_lines);
+    set_original_newline_count(table);
+}
+
+size_t size(const PieceTable& table)
+{
+    return table.pieces.summary.bytes;
+}
+
+size_t line_count(const PieceTable& table)
+{
+    if (is_indexing(table)) {
+        return line_index::newline_count(table.original_lines) + 1;
+    }
+    return table.pieces.summary.newlines + 1;
+}
+
+bool has_line(const PieceTable& table, size_t row)
+{
+    if (row == 0) {
+        return true;
+    }
+    if (is_indexing(table)) {
+        return line_index::has_newline(table.original_lines, row - 1);
+    }
+    return row <= table.pieces.summary.newlines;
+}
+
+size_t line_start(const PieceTable& table, size_t row)
+{
+    if (row == 0) {
+        return 0;
+    }
+    if (is_indexing(table)) {
+        // The text is the original buffer, as it was loaded
+        if (!line_index::has_newline(table.original_lines, row - 1)) {
+            return size(table);
+        }
+        return line_index::newline_offset(table.original_lines, row - 1) + 1;
+    }
+    if (row > table.pieces.summary.newlines) {
+        return size(table);
+    }
+    // Descend to the piece holding the newline ending the previous line
+    size_t remaining = row;
+    size_t offset = 0;
+    const auto* leaf = static_cast<const Leaf*>(
+        btree::find_newline(table.pieces.root, remaining, offset));
+    for (size_t index = 0; index < leaf->count; index++) {
+        const Piece& piece = leaf->items[index];
+        if (remaining <= piece.newline_count) {
+            size_t newline_index
+                = first_newline_index(table, piece.source, piece.start)
+                + remaining - 1;
+            size_t newline
+                = newline_offset(table, piece.source, newline_index);
+            return offset + (newline - piece.start) + 1;
+        }
+        remaining -= piece.newline_count;
+        offset += piece.length;
+    }
+    return size(table);
+}
+
+size_t line_length(const PieceTable& table, size_t row)
+{
+    size_t start = line_start(table, row);
+    if (!has_line(table, row + 1)) {
+        return size(table) - start;
+    }
+    return line_start(table, row + 1) - start - 1;
+}
+
+size_t next_add_start(const PieceTable& table, size_t length)
+{
+    if (table.add_chunks.empty()) {
+        return 0;
+    }
+    const AddChunk& last = table.add_chunks.back();
+    size_t chunk_end = last.start + last.capacity;
+    return table.add_end + length <= chunk_end ? table.add_end : chunk_end + 1;
+}
+
+// Append text to the add buffer, in a new chunk if it does not fit in the last
+// one, and return its offset
+static size_t append(PieceTable& table, std::string_view text)
+{
+    size_t start = next_add_start(table, text.size());
+    if (table.add_chunks.empty() || start != table.add_end) {
+        size_t capacity = std::max(add_chunk_capacity, text.size());
+        table.add_chunks.push_back(AddChunk {
+            .start = start,
+            .capacity = capacity,
+            .data = static_cast<char*>(table.resource->allocate(capacity, 1)),
+        });
+    }
+    AddChunk& chunk = table.add_chunks.back();
+    text.copy(chunk.data + (start - chunk.start), text.size());
+    table.add_end = start + text.size();
+    return start;
+}
+
+static std::string_view source_text(
+    std::string_view original,
+    std::span<const AddChunk> add_chunks,
+    Source source,
+    size_t start,
+    size_t length)
+{
+    if (source == Source::Original) {
+        return original.substr(start, length);
+    }
+    const AddChunk& chunk
+        = *(std::ranges::upper_bound(add_chunks, start, {}, &AddChunk::start)
+            - 1);
+    return { chunk.data + (start - chunk.start), length };
+}
+
+std::string_view source_text(
+    const PieceTable& table,
+    Source source,
+    size_t start,
+    size_t length)
+{
+    return source_text(table.original, table.add_chunks, source, start, length);
+}
+
+// Insert a piece at `offset` in a leaf, relative to the leaf. Return the new
+// right sibling of the leaf, if split.
+static Leaf* insert_in_leaf(
+    const PieceTable& table,
+    Leaf& leaf,
+    size_t offset,
+    const Piece& inserted)
+{
+    std::pmr::memory_resource* resource = table.pieces.resource;
+    size_t index = 0;
+    size_t piece_offset = 0;
+    while (index < leaf.count
+           && piece_offset + leaf.items[index].length < offset) {
+        piece_offset += leaf.items[index].length;
+        index++;
+    }
+    if (index == leaf.count || offset == piece_offset) {
+        return btree::insert_items(resource, leaf, index, { &inserted, 1 });
+    }
+    Piece& piece = leaf.items[index];
+    if (offset == piece_offset + piece.length) {
+        // Typing appends to the add buffer right after the previous insertion,
+        // so the piece ending at the insertion point can simply be extended
+        if (piece.source == inserted.source
+            && piece.start + piece.length == inserted.start) {
+            piece.length += inserted.length;
+            piece.newline_count += inserted.newline_count;
+            return nullptr;
+        }
+        return btree::insert_items(
+            resource,
+            leaf,
+            index + 1,
+            { &inserted, 1 });
+    }
+    // Split the piece containing the insertion point
+    size_t left_length = offset - piece_offset;
+    Piece right = make_piece(
+        table,
+        piece.source,
+        piece.start + left_length,
+        piece.length - left_length);
+    piece.length = left_length;
+    piece.newline_count -= right.newline_count;
+    const Piece pieces[] = { inserted, right };
+    return btree::insert_items(resource, leaf, index + 1, pieces);
+}
+
+// Insert a piece whose offset is within the text
+static void insert_piece_at(
+    PieceTable& table,
+    size_t offset,
+    const Piece& inserted)
+{
+    btree::insert(table.pieces, offset, [&](Leaf& leaf, size_t leaf_offset) {
+        return insert_in_leaf(table, leaf, leaf_offset, inserted);
+    });
+}
+
+void insert(PieceTable& table, size_t offset, std::string_view text)
+{
+    if (text.empty()) {
+        return;
+    }
+    finish_indexing(table);
+    offset = std::min(offset, size(table));
+
+    size_t add_start = append(table, text);
+    line_index::find_newlines(text, add_start, table.add_newlines);
+    insert_piece_at(
+        table,
+        offset,
+        make_piece(table, Source::Add, add_start, text.size()));
+}
+
+void insert_piece(
+    PieceTable& table,
+    size_t offset,
+    Source source,
+    size_t start,
+    size_t length)
+{
+    if (length == 0) {
+        return;
+    }
+    finish_indexing(table);
+    offset = std::min(offset, size(table));
+    insert_piece_at(table, offset, make_piece(table, source, start, length));
+}
+
+// Piece containing `offset`, which must be within the text, and the offset of
+// its first character
+static const Piece& find_piece(
+    const PieceTable& table,
+    size_t offset,
+    size_t& piece_offset)
+{
+    const auto* leaf = static_cast<const Leaf*>(
+        btree::find_offset(table.pieces.root, offset, piece_offset));
+    size_t index = 0;
+    while (offset >= piece_offset + leaf->items[index].length) {
+        piece_offset += leaf->items[index].length;
+        index++;
+    }
+    return leaf->items[index];
+}
+
+// Erase the range [start, end) relative to the beginning of a leaf. The range
+// must not lie strictly inside a single piece, which would split it.
+static void erase_in_leaf(
+    const PieceTable& table,
+    Leaf& leaf,
+    size_t start,
+    size_t end)
+{
+    size_t piece_start = 0;
+    size_t kept = 0;
+    for (size_t index = 0; index < leaf.count; index++) {
+        Piece piece = leaf.items[index];
+        size_t piece_end = piece_start + piece.length;
+        if (piece_end > start && piece_start < end) {
+            // Keep the part outside of the range, on one side only
+            size_t keep_start = piece_start < start ? piece_start : end;
+            size_t keep_end = piece_start < start ? start : piece_end;
+            piece = keep_start < keep_end
+                ? make_piece(
+                      table,
+                      piece.source,
+                      piece.start + (keep_start - piece_start),
+                      keep_end - keep_start)
+                : Piece {};
+        }
+        if (piece.length > 0) {
+            leaf.items[kept++] = piece;
+        }
+        piece_start = piece_end;
+    }
+    leaf.count = kept;
+}
+
+void erase(PieceTable& table, size_t offset, size_t length)
+{
+    if (offset >= size(table) || length == 0) {
+        return;
+    }
+    finish_indexing(table);
+    length = std::min(length, size(table) - offset);
+    size_t end = offset + length;
+
+    // Erasing the middle of a piece splits it: erase up to the end of the
+    // piece, then insert back the part following the range
+    size_t piece_offset = 0;
+    Piece piece = find_piece(table, offset, piece_offset);
+    size_t piece_end = piece_offset + piece.length;
+    std::optional<Piece> right;
+    if (offset > piece_offset && end < piece_end) {
+        right = make_piece(
+            table,
+            piece.source,
+            piece.start + (end - piece_offset),
+            piece_end - end);
+        end = piece_end;
+    }
+
+    btree::erase(
+        table.pieces,
+        offset,
+        end,
+        [&](Leaf& leaf, size_t leaf_start, size_t leaf_end) {
+            erase_in_leaf(table, leaf, leaf_start, leaf_end);
+        });
+
+    if (right) {
+        insert_piece_at(table, offset, *right);
+    }
+}
+
+Snapshot snapshot(const PieceTable& table)
+{
+    Snapshot copy;
+    copy.original = table.original;
+    copy.add_chunks.assign(table.add_chunks.begin(), table.add_chunks.end());
+    copy.pieces = btree::snapshot(table.pieces);
+    return copy;
+}
+
+size_t size(const Snapshot& snapshot)
+{
+    return snapshot.pieces.summary.bytes;
+}
+
+std::string_view source_text(
+    const Snapshot& snapshot,
+    Source source,
+    size_t start,
+    size_t length)
+{
+    return source_text(
+        snapshot.original,
+        snapshot.add_chunks,
+        source,
+        start,
+        length);
+}
+
+} // namespace ted::piece_table
@@ -0,0 +1,287 @@
+#ifndef TED_PIECE_TABLE_HPP_
+#define TED_PIECE_TABLE_HPP_
+
+#include <ted/btree.hpp>
+#include <ted/line_index.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace ted::piece_table {
+
+enum class Source : uint8_t {
+    Original,
+    Add,
+};
+
+// A contiguous span of text taken from one of the source buffers
+struct Piece {
+    Source source;
+    size_t start;
+    size_t length;
+    size_t newline_count;
+};
+
+// Maximum number of pieces held by a leaf
+inline constexpr size_t leaf_capacity = 32;
+
+// Leaves of the table, holding arrays of pieces
+struct Traits {
+    using Item = Piece;
+    static constexpr size_t leaf_capacity = piece_table::leaf_capacity;
+
+    static btree::Summary summarize(std::span<const Piece> pieces);
+};
+
+using Leaf = btree::Leaf<Traits>;
+
+// Capacity of the chunks of the add buffer. Larger insertions get a chunk of
+// their own.
+inline constexpr size_t add_chunk_capacity = 64 * 1024;
+
+// Part of the add buffer. Chunks are never reallocated, so the text appended to
+// them stays in place and can be read by snapshots while more is appended.
+struct AddChunk {
+    // Offset of the first character of the chunk in the add buffer. The offsets
+    // skip one character between chunks, so that a range of the add buffer
+    // following another one is always in the same chunk.
+    size_t start;
+    size_t capacity;
+    char* data;
+};
+
+// Text storage made of an immutable original buffer, not owned by the table,
+// holding the text as loaded, an append-only add buffer receiving every
+// inserted text in chunks which are never moved, and a list of pieces
+// describing how the text is assembled from both buffers.
+// Edits only split, trim or insert the pieces around the edited range and never
+// copy the original buffer. The pieces are kept in order in a B-tree whose
+// leaves hold arrays of pieces, so that finding the piece at an offset or a
+// line, inserting and erasing pieces are O(log n) in the number of pieces. The
+// newline offsets of each source buffer are indexed once so that line lookups
+// do not need to scan the text.
+// The add buffer and the nodes are allocated from the memory resource given on
+// construction, which must outlive the table. The index of the original buffer
+// is not, as it may be built by another thread.
+struct PieceTable {
+    std::string_view original;
+    line_index::LineIndex original_lines;
+    std::pmr::vector<AddChunk> add_chunks;
+    // Offset in the add buffer following the last appended text
+    size_t add_end = 0;
+    line_index::Offsets add_newlines;
+    btree::Tree<Traits> pieces;
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+    PieceTable() = default;
+    explicit PieceTable(std::pmr::memory_resource* resource);
+    PieceTable(const PieceTable&) = delete;
+    PieceTable(PieceTable&& other) noexcept;
+    PieceTable& operator=(const PieceTable&) = delete;
+    PieceTable& operator=(PieceTable&& other) noexcept;
+    ~PieceTable();
+};
+
+// Reset the table to hold the given text as its original buffer. The text must
+// outlive the table.
+void init(PieceTable& table, std::string_view original);
+
+// Same as init(), but the text is made of the given pieces of the original
+// buffer rather than of the whole buffer. The pieces may repeat ranges of it,
+// such as the lines of a text of which only the distinct ones are kept, and
+// their newline counts must be the ones of their ranges.
+void init(
+    PieceTable& table,
+    std::string_view original,
+    std::span<const Piece> pieces);
+
+// Same as init(), but only the newlines of the original buffer needed to reach
+// `min_lines` lines are indexed right away, the rest being indexed in the
+// background. Until finish_indexing() is called, line lookups beyond the
+// indexed part wait for the background indexing to reach them.
+void init_progressive(
+    PieceTable& table,
+    std::string_view original,
+    size_t min_lines);
+
+// Whether the original buffer is being indexed in the background
+[[nodiscard]]
+bool is_indexing(const PieceTable& table);
+
+// Percentage of the original buffer indexed so far
+[[nodiscard]]
+unsigned indexing_progress(const PieceTable& table);
+
+// Wait for the background indexing of the original buffer to complete, if
+// any. Edits call it first as they need the newline count of every piece.
+void finish_indexing(PieceTable& table);
+
+[[nodiscard]]
+size_t size(const PieceTable& table);
+
+// A text always has at least one (possibly empty) line, and one more line for
+// each newline character
+[[nodiscard]]
+size_t line_count(const PieceTable& table);
+
+// Whether the text has at least `row + 1` lines. Unlike line_count(), this
+// does not wait for the whole original buffer to be indexed.
+[[nodiscard]]
+bool has_line(const PieceTable& table, size_t row);
+
+// Offset of the first character of a line, or the text size if the line does
+// not exist
+[[nodiscard]]
+size_t line_start(const PieceTable& table, size_t row);
+
+// Length of a line, not including its newline character
+[[nodiscard]]
+size_t line_length(const PieceTable& table, size_t row);
+
+void insert(PieceTable& table, size_t offset, std::string_view text);
+void erase(PieceTable& table, size_t offset, size_t length);
+
+// Insert a range of one of the source buffers, such as one which was part of
+// the text before being erased, without copying it. The buffers never change
+// so the range always holds the same text.
+void insert_piece(
+    PieceTable& table,
+    size_t offset,
+    Source source,
+    size_t start,
+    size_t length);
+
+// Offset in the add buffer at which the next inserted text of `length`
+// characters will be appended
+[[nodiscard]]
+size_t next_add_start(const PieceTable& table, size_t length);
+
+// Text of a range of one of the source buffers, such as the range of a piece
+[[nodiscard]]
+std::string_view source_text(
+    const PieceTable& table,
+    Source source,
+    size_t start,
+    size_t length);
+
+// Forget the nodes and the add buffer of the table without giving them back to
+// its resource, for when the resource is about to be released as a whole. The
+// snapshots of the table must be destroyed beforehand.
+void release(PieceTable& table);
+
+// Table sharing the nodes and the add buffer chunks of another one, taken
+// without copying any text or piece. The snapshot can be read from another
+// thread while the table is edited, as the edits copy the shared nodes instead
+// of modifying them and only append past the text of the snapshot, but must be
+// destroyed by the thread editing the table, before the table.
+struct Snapshot {
+    std::string_view original;
+    std::vector<AddChunk> add_chunks;
+    btree::Tree<Traits> pieces;
+};
+
+[[nodiscard]]
+Snapshot snapshot(const PieceTable& table);
+
+[[nodiscard]]
+size_t size(const Snapshot& snapshot);
+
+[[nodiscard]]
+std::string_view source_text(
+    const Snapshot& snapshot,
+    Source source,
+    size_t start,
+    size_t length);
+
+// Call `visitor` with the source, start and length of each piece, or part of a
+// piece, making up the range [start, end) of the pieces of a tree, in order
+template<class Visitor>
+void for_each_piece_in_tree(
+    const btree::Tree<Traits>& pieces,
+    size_t start,
+    size_t end,
+    Visitor& visitor)
+{
+    auto visit = [&](const Leaf& leaf, size_t leaf_start, size_t leaf_end) {
+        size_t piece_start = 0;
+        for (size_t index = 0; index < leaf.count; index++) {
+            const Piece& piece = leaf.items[index];
+            size_t piece_end = piece_start + piece.length;
+            if (piece_start >= leaf_end) {
+                break;
+            }
+            if (piece_end > leaf_start) {
+                size_t skip = std::max(leaf_start, piece_start) - piece_start;
+                visitor(
+                    piece.source,
+                    piece.start + skip,
+                    std::min(leaf_end, piece_end) - piece_start - skip);
+            }
+            piece_start = piece_end;
+        }
+    };
+    btree::for_each_leaf<Traits>(pieces.root, start, end, visit);
+}
+
+// Call `visitor` with the source, start and length of each piece, or part of a
+// piece, making up the range [offset, offset + length), in order
+template<class Visitor>
+void for_each_piece(
+    const PieceTable& table,
+    size_t offset,
+    size_t length,
+    Visitor&& visitor)
+{
+    size_t text_size = size(table);
+    offset = std::min(offset, text_size);
+    size_t end = offset + std::min(length, text_size - offset);
+    for_each_piece_in_tree(table.pieces, offset, end, visitor);
+}
+
+// Call `visitor` with the source, start and length of each piece making up a
+// snapshot, in order
+template<class Visitor>
+void for_each_piece(const Snapshot& snapshot, Visitor&& visitor)
+{
+    if (snapshot.pieces.root != nullptr) {
+        for_each_piece_in_tree(snapshot.pieces, 0, size(snapshot), visitor);
+    }
+}
+
+// Call `visitor` with each contiguous span of text making up the range
+// [offset, offset + length), in order
+template<class Visitor>
+void for_each_span(
+    const PieceTable& table,
+    size_t offset,
+    size_t length,
+    Visitor&& visitor)
+{
+    for_each_piece(
+        table,
+        offset,
+        length,
+        [&](Source source, size_t start, size_t span_length) {
+            visitor(source_text(table, source, start, span_length));
+        });
+}
+
+// Call `visitor` with each span of text making up a snapshot, in order
+template<class Visitor>
+void for_each_span(const Snapshot& snapshot, Visitor&& visitor)
+{
+    for_each_piece(
+        snapshot,
+        [&](Source source, size_t start, size_t length) {
+            visitor(source_text(snapshot, source, start, length));
+        });
+}
+
+} // namespace ted::piece_table
+
+#endif // TED_PIECE_TABLE_HPP_
@@ -0,0 +1,217 @@
+#include <ted/event_loop.hpp>
+#include <ted/os.hpp>
+
+#include <signal.h> // NOLINT(*deprecated-headers*): sigset_t is not standard C++
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+
+namespace ted::event_loop {
+
+enum class Kind : uint8_t {
+    Unused,
+    Fd,
+    Signal,
+    Timer,
+    Notifier,
+};
+
+struct Source {
+    Kind kind = Kind::Unused;
+    int fd = -1;
+    Handler* handler = nullptr;
+    // Called instead of `handler` once a descriptor is hung up
+    Handler* hangup_handler = nullptr;
+    void* userdata = nullptr;
+};
+
+// The sources are never moved, so that notify() can read the descriptor of a
+// notifier from another thread while sources are added
+static constexpr size_t max_source_count = 32;
+
+// Events handled by a single wait
+static constexpr int max_event_count = 16;
+
+static struct {
+    int epoll_fd;
+    std::array<Source, max_source_count> sources;
+} loop {
+    .epoll_fd = -1,
+    .sources = {},
+};
+
+void init()
+{
+    loop.epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (loop.epoll_fd == -1) {
+        os::exit_err("epoll_create1() failed");
+    }
+}
+
+static SourceId add_source(Kind kind, int fd, Handler* handler, void* userdata)
+{
+    SourceId id = 0;
+    while (id < max_source_count && loop.sources[id].kind != Kind::Unused) {
+        id++;
+    }
+    if (id == max_source_count) {
+        os::exit_err("event_loop: too many event sources");
+    }
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.u32 = id;
+    if (::epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        os::exit_err("epoll_ctl() failed");
+    }
+    loop.sources[id] = Source {
+        .kind = kind,
+        .fd = fd,
+        .handler = handler,
+        .userdata = userdata,
+    };
+    return id;
+}
+
+SourceId add_fd(
+    int fd,
+    Handler* handler,
+    Handler* hangup_handler,
+    void* userdata)
+{
+    SourceId id = add_source(Kind::Fd, fd, handler, userdata);
+    loop.sources[id].hangup_handler = hangup_handler;
+    return id;
+}
+
+SourceId add_signal(int signal, Handler* handler, void* userdata)
+{
+    sigset_t mask {};
+    sigemptyset(&mask);
+    sigaddset(&mask, signal);
+    if (::pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0) {
+        os::exit_err("pthread_sigmask() failed");
+    }
+    int fd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd == -1) {
+        os::exit_err("signalfd() failed");
+    }
+    return add_source(Kind::Signal, fd, handler, userdata);
+}
+
+SourceId add_timer(Handler* handler, void* userdata)
+{
+    int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        os::exit_err("timerfd_create() failed");
+    }
+    return add_source(Kind::Timer, fd, handler, userdata);
+}
+
+void set_timer(SourceId timer, int interval_ms)
+{
+    timespec interval {
+        .tv_sec = interval_ms / 1000,
+        .tv_nsec = static_cast<long>(interval_ms % 1000) * 1'000'000,
+    };
+    itimerspec spec {
+        .it_interval = interval,
+        .it_value = interval,
+    };
+    if (::timerfd_settime(loop.sources[timer].fd, 0, &spec, nullptr) == -1) {
+        os::exit_err("timerfd_settime() failed");
+    }
+}
+
+SourceId add_notifier(Handler* handler, void* userdata)
+{
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1) {
+        os::exit_err("eventfd() failed");
+    }
+    return add_source(Kind::Notifier, fd, handler, userdata);
+}
+
+void notify(SourceId notifier)
+{
+    // The counter only overflows after 2^64 - 1 notifications not handled, the
+    // write cannot fail otherwise
+    uint64_t count = 1;
+    (void)::write(loop.sources[notifier].fd, &count, sizeof(count));
+}
+
+void remove(SourceId source)
+{
+    Source& removed = loop.sources[source];
+    (void)::epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, removed.fd, nullptr);
+    if (removed.kind != Kind::Fd) {
+        ::close(removed.fd);
+    }
+    removed = Source {};
+}
+
+// Consume the pending events of the descriptors owned by the loop, so that they
+// are not reported again
+static void drain(const Source& source)
+{
+    switch (source.kind) {
+    case Kind::Signal: {
+        signalfd_siginfo info {};
+        while (::read(source.fd, &info, sizeof(info)) == sizeof(info)) { }
+        break;
+    }
+    case Kind::Timer:
+    case Kind::Notifier: {
+        uint64_t count = 0;
+        (void)::read(source.fd, &count, sizeof(count));
+        break;
+    }
+    case Kind::Unused:
+    case Kind::Fd:
+        break;
+    }
+}
+
+bool run_once(int timeout_ms)
+{
+    std::array<epoll_event, max_event_count> events {};
+    int count = ::epoll_wait(
+        loop.epoll_fd,
+        events.data(),
+        max_event_count,
+        timeout_ms);
+    if (count == -1) {
+        if (errno == EINTR) {
+            return true;
+        }
+        os::exit_err("epoll_wait() failed");
+    }
+    for (int index = 0; index < count; index++) {
+        // The source may have been removed by a previous handler
+        SourceId id = events[index].data.u32;
+        Source source = loop.sources[id];
+        if (source.kind == Kind::Unused) {
+            continue;
+        }
+        if (source.kind == Kind::Fd
+            && (events[index].events & (EPOLLHUP | EPOLLERR)) != 0) {
+            remove(id);
+            if (source.hangup_handler != nullptr) {
+                source.hangup_handler(source.userdata);
+            }
+            continue;
+        }
+        drain(source);
+        if (source.handler != nullptr) {
+            source.handler(source.userdata);
+        }
+    }
+    return count > 0;
+}
+
+} // namespace ted::event_loop
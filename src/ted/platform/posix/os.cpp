@@ -1,8 +1,18 @@
 #include <ted/os.hpp>
 
-#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
 namespace ted::os {
 
 bool isatty(FILE* stream)
@@ -10,4 +20,311 @@ bool isatty(FILE* stream)
     return ::isatty(fileno(stream)) == 1;
 }
 
+static void unmap(MappedFile& mapped_file)
+{
+    if (mapped_file.size > 0) {
+        // NOLINTNEXTLINE(*const-cast*): munmap() does not modify the data
+        (void)::munmap(const_cast<char*>(mapped_file.data), mapped_file.size);
+    }
+    if (mapped_file.fd != -1) {
+        (void)::close(mapped_file.fd);
+    }
+    mapped_file.data = nullptr;
+    mapped_file.size = 0;
+    mapped_file.fd = -1;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(std::exchange(other.data, nullptr))
+    , size(std::exchange(other.size, 0))
+    , fd(std::exchange(other.fd, -1))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        unmap(*this);
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        fd = std::exchange(other.fd, -1);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap(*this);
+}
+
+bool map_file(const char* path, MappedFile& mapped_file)
+{
+    unmap(mapped_file);
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode)) {
+        (void)::close(fd);
+        return false;
+    }
+    auto size = static_cast<size_t>(file_stat.st_size);
+    if (size > 0) {
+        // Private read-only mapping: pages are loaded lazily from the page
+        // cache and never copied unless written, which only privatize() does
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            (void)::close(fd);
+            return false;
+        }
+        mapped_file.data = static_cast<const char*>(data);
+        mapped_file.size = size;
+    }
+    mapped_file.fd = fd;
+    return true;
+}
+
+bool is_same_file(const MappedFile& mapped_file, const char* path)
+{
+    struct stat mapped_stat {};
+    struct stat path_stat {};
+    return ::fstat(mapped_file.fd, &mapped_stat) == 0
+        && ::stat(path, &path_stat) == 0
+        && mapped_stat.st_dev == path_stat.st_dev
+        && mapped_stat.st_ino == path_stat.st_ino;
+}
+
+static size_t page_size()
+{
+    static const auto size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+bool privatize(const MappedFile& mapped_file, size_t offset, size_t length)
+{
+    if (offset >= mapped_file.size || length == 0) {
+        return true;
+    }
+    length = std::min(length, mapped_file.size - offset);
+    size_t aligned_offset = offset - (offset % page_size());
+    length += offset - aligned_offset;
+
+    // NOLINTNEXTLINE(*const-cast*): the pages are written with their content
+    auto* pages = const_cast<char*>(mapped_file.data + aligned_offset);
+    if (::mprotect(pages, length, PROT_READ | PROT_WRITE) == -1) {
+        return false;
+    }
+    // Writing a page of a private mapping copies it, with the same content
+    for (size_t page = 0; page < length; page += page_size()) {
+        volatile char* byte = pages + page;
+        *byte = *byte;
+    }
+    (void)::mprotect(pages, length, PROT_READ);
+    return true;
+}
+
+void advise(
+    const MappedFile& mapped_file,
+    size_t offset,
+    size_t length,
+    Advice advice)
+{
+    static constexpr std::array advices {
+        MADV_NORMAL,
+        MADV_SEQUENTIAL,
+        MADV_WILLNEED,
+    };
+    if (offset >= mapped_file.size) {
+        return;
+    }
+    length = std::min(length, mapped_file.size - offset);
+
+    // madvise() requires a page-aligned address
+    size_t aligned_offset = offset - (offset % page_size());
+    length += offset - aligned_offset;
+
+    // NOLINTNEXTLINE(*const-cast*): madvise() does not modify the data
+    void* address = const_cast<char*>(mapped_file.data + aligned_offset);
+    (void)::madvise(address, length, advices[std::to_underlying(advice)]);
+}
+
+// Spans written by a single writev(), at most IOV_MAX
+static constexpr size_t max_queued_spans = 1024;
+static constexpr size_t max_queued_size = size_t { 4 } * 1024 * 1024;
+
+FileWriter::~FileWriter()
+{
+    if (fd != -1) {
+        (void)::close(fd);
+        if (!temp_path.empty()) {
+            (void)::unlink(temp_path.c_str());
+        }
+    }
+}
+
+bool open_writer(FileWriter& writer, const char* path)
+{
+    // Replace the target of a symbolic link rather than the link
+    char* resolved_path = ::realpath(path, nullptr);
+    writer.path = resolved_path != nullptr ? resolved_path : path;
+    std::free(resolved_path); // NOLINT(*no-malloc*): allocated by realpath()
+    writer.temp_path = writer.path + ".ted-XXXXXX";
+    writer.fd = ::mkostemp(writer.temp_path.data(), O_CLOEXEC);
+    if (writer.fd == -1) {
+        return false;
+    }
+    struct stat file_stat {};
+    return ::stat(writer.path.c_str(), &file_stat) == -1
+        || ::fchmod(writer.fd, file_stat.st_mode & 07777) == 0;
+}
+
+static bool flush(FileWriter& writer)
+{
+    std::array<iovec, max_queued_spans> iovecs {};
+    size_t count = 0;
+    for (std::string_view span : writer.queued) {
+        // NOLINTNEXTLINE(*const-cast*): writev() does not modify the data
+        iovecs[count++] = iovec { const_cast<char*>(span.data()), span.size() };
+    }
+    writer.queued.clear();
+    writer.queued_size = 0;
+    iovec* first = iovecs.data();
+    while (count > 0) {
+        ssize_t written = ::writev(writer.fd, first, static_cast<int>(count));
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        // Skip what was written, which may end in the middle of a span
+        auto remaining = static_cast<size_t>(written);
+        while (count > 0 && remaining >= first->iov_len) {
+            remaining -= first->iov_len;
+            first++;
+            count--;
+        }
+        if (count > 0) {
+            first->iov_base = static_cast<char*>(first->iov_base) + remaining;
+            first->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+bool write(FileWriter& writer, std::string_view span)
+{
+    if (span.empty()) {
+        return true;
+    }
+    writer.queued.push_back(span);
+    writer.queued_size += span.size();
+    return (writer.queued.size() < max_queued_spans
+            && writer.queued_size < max_queued_size)
+        || flush(writer);
+}
+
+bool copy_range(
+    FileWriter& writer,
+    const MappedFile& source,
+    size_t offset,
+    size_t length)
+{
+    // The queued spans come first in the file
+    if (!flush(writer)) {
+        return false;
+    }
+    auto source_offset = static_cast<off_t>(offset);
+    while (length > 0) {
+        ssize_t copied = ::copy_file_range(
+            source.fd,
+            &source_offset,
+            writer.fd,
+            nullptr,
+            length,
+            0);
+        if (copied == -1 && errno == EINTR) {
+            continue;
+        }
+        if (copied == -1
+            && (errno == EXDEV || errno == EINVAL || errno == ENOSYS
+                || errno == EOPNOTSUPP)) {
+            // Not supported between these files
+            return write(
+                writer,
+                std::string_view(source.data + source_offset, length));
+        }
+        if (copied <= 0) {
+            // The file was truncated by another program
+            if (copied == 0) {
+                errno = EIO;
+            }
+            return false;
+        }
+        length -= static_cast<size_t>(copied);
+    }
+    return true;
+}
+
+bool open_in_place(FileWriter& writer, const char* path)
+{
+    writer.path = path;
+    writer.temp_path.clear();
+    writer.fd = ::open(path, O_WRONLY | O_CLOEXEC);
+    return writer.fd != -1;
+}
+
+bool write_at(FileWriter& writer, size_t offset, std::string_view text)
+{
+    while (!text.empty()) {
+        ssize_t written = ::pwrite(
+            writer.fd,
+            text.data(),
+            text.size(),
+            static_cast<off_t>(offset));
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        text.remove_prefix(static_cast<size_t>(written));
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool commit(FileWriter& writer)
+{
+    if (!flush(writer) || ::fsync(writer.fd) == -1) {
+        return false;
+    }
+    int fd = std::exchange(writer.fd, -1);
+    if (writer.temp_path.empty()) {
+        return ::close(fd) == 0;
+    }
+    if (::close(fd) == -1
+        || ::rename(writer.temp_path.c_str(), writer.path.c_str()) == -1) {
+        int error = errno;
+        (void)::unlink(writer.temp_path.c_str());
+        errno = error;
+        return false;
+    }
+    // The rename is only persisted once the directory is synced too
+    size_t slash = writer.path.rfind('/');
+    std::string directory = slash == std::string::npos
+        ? std::string(".")
+        : writer.path.substr(0, std::max<size_t>(slash, 1));
+    int directory_fd
+        = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory_fd == -1) {
+        return false;
+    }
+    bool synced = ::fsync(directory_fd) == 0;
+    (void)::close(directory_fd);
+    return synced;
+}
+
 } // namespace ted::os
@@ -1,18 +1,24 @@
 #include <ted/editor.hpp>
+#include <ted/event_loop.hpp>
 #include <ted/os.hpp>
 #include <ted/term.hpp>
 #include <ted/tui.hpp>
 
 #include <fcntl.h>
-#include <signal.h> // NOLINT(*deprecated-headers*): sigaction is not standard C++
+#include <poll.h>
+#include <signal.h> // NOLINT(*deprecated-headers*): SIGWINCH is not standard C++
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string_view>
 
 namespace ted::term {
 
@@ -21,13 +27,18 @@ static struct {
     int stdin_flags;
     int stdout_fd;
     termios stdout_initial_termios;
-    bool terminal_resized;
+    // Set by the event loop when stdin becomes readable
+    bool input_ready;
+    // Set once stdin is closed. Its input is a terminal in raw mode, whose reads
+    // only end when the terminal itself is gone.
+    bool input_closed;
 } state {
     .stdin_fd = STDIN_FILENO,
     .stdin_flags = 0,
     .stdout_fd = STDOUT_FILENO,
     .stdout_initial_termios = {},
-    .terminal_resized = false,
+    .input_ready = false,
+    .input_closed = false,
 };
 
 static void disable_raw_mode()
@@ -48,13 +59,6 @@ static void enable_raw_mode()
         state.stdin_flags = stdin_flags;
     }
 
-    // Set state.terminal_resized to true whenever we get SIGWINCH
-    struct sigaction action {};
-    action.sa_handler = [](int /*signal*/) { state.terminal_resized = true; };
-    if (sigaction(SIGWINCH, &action, nullptr) != 0) {
-        os::exit_err("sigaction(SIGWINCH) failed");
-    }
-
     // Get the original termios
     termios raw {};
     if (tcgetattr(state.stdout_fd, &raw) != 0) {
@@ -98,8 +102,22 @@ static void enable_raw_mode()
     }
 }
 
+// No more input can come once stdin is closed, such as when the terminal is
+// closed or the connection to it dropped
+[[noreturn]]
+static void exit_input_closed()
+{
+    state.input_closed = true;
+    os::exit_err("stdin closed");
+}
+
 static void deinit()
 {
+    // Nothing is left to restore once the terminal is gone
+    if (state.input_closed) {
+        return;
+    }
+    disable_bracketed_paste();
     disable_raw_mode();
     enter_main_screen_buffer();
 }
@@ -108,8 +126,20 @@ void init()
 {
     enter_alternate_screen_buffer();
     enable_raw_mode();
+    enable_bracketed_paste();
 
     os::at_exit(os::Ring::_1, deinit);
+
+    // Resizes are handled by the event loop between two waits for input
+    event_loop::add_signal(
+        SIGWINCH,
+        [](void*) { tui::handle_resize(); },
+        nullptr);
+    event_loop::add_fd(
+        state.stdin_fd,
+        [](void*) { state.input_ready = true; },
+        [](void*) { exit_input_closed(); },
+        nullptr);
 }
 
 bool get_size(size_t& rows, size_t& columns)
@@ -123,26 +153,115 @@ bool get_size(size_t& rows, size_t& columns)
     return true;
 }
 
-bool read_key(uint8_t& byte)
+// Input bytes read from the terminal but not consumed yet. Everything available
+// is read at once when it is empty, so that pasted text or escape sequences do
+// not cost a system call per byte.
+static struct {
+    std::array<uint8_t, 64 * 1024> bytes;
+    size_t begin;
+    size_t end;
+} input {};
+
+// Read the available input into the empty input buffer, return false if there
+// is none yet. Exit at the end of the input.
+static bool refill_input()
 {
-    if (::read(STDIN_FILENO, &byte, 1) == EOF) {
-        if (errno == EAGAIN) {
-            return false; // timeout, nothing to read
+    ssize_t count
+        = ::read(state.stdin_fd, input.bytes.data(), input.bytes.size());
+    if (count == EOF) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return false;
         }
-        if (errno == EINTR && state.terminal_resized) {
-            state.terminal_resized = false;
-            tui::handle_resize();
-            return true; // interruption, break the caller read loop
+        // Reading a pseudo-terminal whose other side was closed fails
+        if (errno == EIO) {
+            exit_input_closed();
         }
         os::exit_err("read() failed");
     }
+    if (count == 0) {
+        exit_input_closed();
+    }
+    input.begin = 0;
+    input.end = static_cast<size_t>(count);
     return true;
 }
 
+bool read_key(uint8_t& byte)
+{
+    if (input.begin == input.end && !refill_input()) {
+        return false;
+    }
+    byte = input.bytes[input.begin++];
+    return true;
+}
+
+std::string_view read_input()
+{
+    if (input.begin == input.end && !refill_input()) {
+        return {};
+    }
+    return std::string_view(
+        reinterpret_cast<const char*>(input.bytes.data() + input.begin),
+        input.end - input.begin);
+}
+
+void consume_input(size_t count)
+{
+    input.begin += std::min(count, input.end - input.begin);
+}
+
+bool wait_input(int timeout_ms)
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point deadline
+        = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!wait_input_or_event(timeout_ms)) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+            deadline - Clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+        timeout_ms = static_cast<int>(remaining.count());
+    }
+    return true;
+}
+
+bool wait_input_or_event(int timeout_ms)
+{
+    if (input.begin != input.end) {
+        return true;
+    }
+    state.input_ready = false;
+    (void)event_loop::run_once(timeout_ms);
+    return state.input_ready;
+}
+
 void print_n(const void* buffer, size_t size)
 {
-    // TODO handle error
-    (void)::write(STDOUT_FILENO, buffer, size);
+    // A frame may not fit in the pty buffer at once, keep writing until all of
+    // it is sent
+    const auto* bytes = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t written = ::write(state.stdout_fd, bytes, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd fd {
+                    .fd = state.stdout_fd,
+                    .events = POLLOUT,
+                    .revents = 0,
+                };
+                (void)::poll(&fd, 1, -1);
+                continue;
+            }
+            // Not exiting here, as restoring the terminal on exit prints too
+            return;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
 }
 
 void print_cstr(const char* str)
@@ -0,0 +1,117 @@
+#include <ted/rope.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ted::rope {
+
+btree::Summary Traits::summarize(std::span<const char> text)
+{
+    const char* end = text.data() + text.size();
+    return btree::Summary {
+        .bytes = text.size(),
+        .newlines = static_cast<size_t>(std::count(text.data(), end, '\n')),
+    };
+}
+
+Rope::Rope(std::pmr::memory_resource* resource)
+    : tree(resource)
+{
+}
+
+void init(Rope& rope, std::string_view text)
+{
+    btree::assign(rope.tree, std::span<const char>(text));
+}
+
+size_t size(const Rope& rope)
+{
+    return rope.tree.summary.bytes;
+}
+
+size_t line_count(const Rope& rope)
+{
+    return rope.tree.summary.newlines + 1;
+}
+
+bool has_line(const Rope& rope, size_t row)
+{
+    return row <= rope.tree.summary.newlines;
+}
+
+size_t line_start(const Rope& rope, size_t row)
+{
+    if (row == 0) {
+        return 0;
+    }
+    if (row > rope.tree.summary.newlines) {
+        return size(rope);
+    }
+    // Descend to the leaf holding the newline ending the previous line
+    size_t remaining = row;
+    size_t offset = 0;
+    const auto* leaf = static_cast<const Leaf*>(
+        btree::find_newline(rope.tree.root, remaining, offset));
+    const char* end = leaf->items + leaf->count;
+    for (const char* it = leaf->items; it < end; it++) {
+        it = static_cast<const char*>(std::memchr(it, '\n', end - it));
+        if (--remaining == 0) {
+            return offset + (it - leaf->items) + 1;
+        }
+    }
+    return size(rope);
+}
+
+size_t line_length(const Rope& rope, size_t row)
+{
+    size_t start = line_start(rope, row);
+    if (row >= rope.tree.summary.newlines) {
+        return size(rope) - start;
+    }
+    return line_start(rope, row + 1) - start - 1;
+}
+
+void insert(Rope& rope, size_t offset, std::string_view text)
+{
+    offset = std::min(offset, size(rope));
+    while (!text.empty()) {
+        std::string_view chunk = text.substr(0, leaf_capacity);
+        btree::insert(rope.tree, offset, [&](Leaf& leaf, size_t leaf_offset) {
+            return btree::insert_items(
+                rope.tree.resource,
+                leaf,
+                leaf_offset,
+                std::span<const char>(chunk));
+        });
+        offset += chunk.size();
+        text.remove_prefix(chunk.size());
+    }
+}
+
+void erase(Rope& rope, size_t offset, size_t length)
+{
+    size_t text_size = size(rope);
+    if (offset >= text_size || length == 0) {
+        return;
+    }
+    length = std::min(length, text_size - offset);
+    btree::erase(
+        rope.tree,
+        offset,
+        offset + length,
+        btree::erase_items<Traits>);
+}
+
+void release(Rope& rope)
+{
+    btree::release(rope.tree);
+}
+
+Rope snapshot(const Rope& rope)
+{
+    Rope copy;
+    copy.tree = btree::snapshot(rope.tree);
+    return copy;
+}
+
+} // namespace ted::rope
@@ -0,0 +1,100 @@
+#ifndef TED_ROPE_HPP_
+#define TED_ROPE_HPP_
+
+#include <ted/btree.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+
+namespace ted::rope {
+
+// Maximum number of bytes of text held by a leaf
+inline constexpr size_t leaf_capacity = 1024;
+
+// Leaves of the rope, holding fixed-size chunks of text
+struct Traits {
+    using Item = char;
+    static constexpr size_t leaf_capacity = rope::leaf_capacity;
+
+    static btree::Summary summarize(std::span<const char> text);
+};
+
+using Leaf = btree::Leaf<Traits>;
+
+// Text storage made of a B-tree whose leaves hold fixed-size chunks of text.
+// The nodes are allocated from the resource given on construction, which must
+// outlive the rope.
+struct Rope {
+    btree::Tree<Traits> tree;
+
+    Rope() = default;
+    explicit Rope(std::pmr::memory_resource* resource);
+};
+
+// Reset the rope to hold a copy of the given text
+void init(Rope& rope, std::string_view text);
+
+[[nodiscard]]
+size_t size(const Rope& rope);
+
+// A text always has at least one (possibly empty) line, and one more line for
+// each newline character
+[[nodiscard]]
+size_t line_count(const Rope& rope);
+
+// Whether the text has at least `row + 1` lines
+[[nodiscard]]
+bool has_line(const Rope& rope, size_t row);
+
+// Offset of the first character of a line, or the text size if the line does
+// not exist
+[[nodiscard]]
+size_t line_start(const Rope& rope, size_t row);
+
+// Length of a line, not including its newline character
+[[nodiscard]]
+size_t line_length(const Rope& rope, size_t row);
+
+void insert(Rope& rope, size_t offset, std::string_view text);
+void erase(Rope& rope, size_t offset, size_t length);
+
+// Forget the nodes of the rope without giving them back to its resource, for
+// when the resource is about to be released as a whole. The snapshots sharing
+// the nodes must be destroyed beforehand.
+void release(Rope& rope);
+
+// Rope sharing the nodes of another one, taken in O(1). The snapshot can be
+// read from another thread while the rope is edited, as the edits copy the
+// shared nodes instead of modifying them, but must be destroyed by the thread
+// editing the rope.
+[[nodiscard]]
+Rope snapshot(const Rope& rope);
+
+// Call `visitor` with each contiguous span of text making up the range
+// [offset, offset + length), in order
+template<class Visitor>
+void for_each_span(
+    const Rope& rope,
+    size_t offset,
+    size_t length,
+    Visitor&& visitor)
+{
+    size_t text_size = size(rope);
+    offset = std::min(offset, text_size);
+    size_t end = offset + std::min(length, text_size - offset);
+    auto visit = [&](const Leaf& leaf, size_t span_start, size_t span_end) {
+        if (span_start < span_end) {
+            visitor(std::string_view(
+                leaf.items + span_start,
+                span_end - span_start));
+        }
+    };
+    btree::for_each_leaf<Traits>(rope.tree.root, offset, end, visit);
+}
+
+} // namespace ted::rope
+
+#endif // TED_ROPE_HPP_
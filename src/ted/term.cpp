@@ -1,12 +1,16 @@
 #include <ted/editor.hpp>
 #include <ted/term.hpp>
 
+#include <algorithm>
 #include <array>
 #include <bit>
 #include <cassert>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
+#include <string>
+#include <string_view>
 #include <utility>
 
 namespace ted::term {
@@ -16,21 +20,21 @@ static void send_code(const char* code)
     editor::screen_buffer_append(code);
 }
 
-void cursor_move(size_t row, size_t col)
-{
-    // Number of char to represent any size_t + 1 of how digits10 is defined
-    // Example: a 8-bit integer type can represent any two-digit number exactly,
-    // but 3-digit decimal numbers 256..999 cannot be represented
-    static constexpr size_t size_t_digit_count
-        = std::numeric_limits<size_t>::digits10 + 1;
+// Number of char to represent any size_t + 1 of how digits10 is defined
+// Example: a 8-bit integer type can represent any two-digit number exactly,
+// but 3-digit decimal numbers 256..999 cannot be represented
+static constexpr size_t size_t_digit_count
+    = std::numeric_limits<size_t>::digits10 + 1;
 
-    // Minimal char count for a valid code "\e[0;0H"
-    static constexpr size_t min_code_len = 6;
+// Minimal char count for a valid code with two parameters "\e[0;0H"
+static constexpr size_t min_code_len = 6;
 
-    // Buffer size rounded up to the greater power of 2
-    static constexpr size_t code_buf_size
-        = std::bit_ceil(min_code_len + (size_t_digit_count * 2));
+// Buffer size rounded up to the greater power of 2
+static constexpr size_t code_buf_size
+    = std::bit_ceil(min_code_len + (size_t_digit_count * 2));
 
+void cursor_move(size_t row, size_t col)
+{
     char code[code_buf_size] {};
     int n = snprintf(code, code_buf_size, "\e[%zu;%zuH", row + 1, col + 1);
     assert(min_code_len <= n && n <= code_buf_size);
@@ -87,6 +91,157 @@ void clear()
     send_code("\e[J");
 }
 
+void set_scroll_region(size_t top, size_t bottom)
+{
+    char code[code_buf_size] {};
+    int n = snprintf(code, code_buf_size, "\e[%zu;%zur", top + 1, bottom);
+    assert(n > 0 && static_cast<size_t>(n) < code_buf_size);
+
+    send_code(code);
+}
+
+void reset_scroll_region()
+{
+    send_code("\e[r");
+}
+
+void scroll_up(size_t rows)
+{
+    char code[code_buf_size] {};
+    int n = snprintf(code, code_buf_size, "\e[%zuS", rows);
+    assert(n > 0 && static_cast<size_t>(n) < code_buf_size);
+
+    send_code(code);
+}
+
+void scroll_down(size_t rows)
+{
+    char code[code_buf_size] {};
+    int n = snprintf(code, code_buf_size, "\e[%zuT", rows);
+    assert(n > 0 && static_cast<size_t>(n) < code_buf_size);
+
+    send_code(code);
+}
+
+void attribute_inverse()
+{
+    send_code("\e[7m");
+}
+
+void attribute_reset()
+{
+    send_code("\e[m");
+}
+
+void begin_synchronized_update()
+{
+    send_code("\e[?2026h");
+}
+
+void end_synchronized_update()
+{
+    send_code("\e[?2026l");
+}
+
+bool read_key_timeout(uint8_t& byte, int timeout_ms)
+{
+    return wait_input(timeout_ms) && read_key(byte);
+}
+
+// Whether a text ends with an answer to the primary device attributes query,
+// made of "\e[?" followed by numbers separated by ';' and a final 'c'
+static bool ends_with_device_attributes(std::string_view text)
+{
+    static constexpr std::string_view prefix = "\e[?";
+    if (!text.ends_with('c')) {
+        return false;
+    }
+    size_t start = text.rfind(prefix);
+    if (start == std::string_view::npos) {
+        return false;
+    }
+    std::string_view params = text.substr(start + prefix.size());
+    params.remove_suffix(1);
+    return std::ranges::all_of(params, [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c)) != 0 || c == ';';
+    });
+}
+
+// Send a query followed by a primary device attributes query, and return what
+// the terminal answered until its answer to the latter. All terminals answer
+// it, so there is no need to wait for the timeout on the ones ignoring the
+// first query.
+static std::string query(std::string_view code, int timeout_ms)
+{
+    std::string request(code);
+    request += "\e[c";
+    print_n(request.data(), request.size());
+
+    std::string answer;
+    uint8_t byte = 0;
+    while (read_key_timeout(byte, timeout_ms)) {
+        answer.push_back(static_cast<char>(byte));
+        if (ends_with_device_attributes(answer)) {
+            break;
+        }
+    }
+    return answer;
+}
+
+bool query_synchronized_update(int timeout_ms)
+{
+    // Query the state of the synchronized update mode (DECRQM), answered with
+    // "\e[?2026;<state>$y" by the terminals knowing it
+    std::string answer = query("\e[?2026$p", timeout_ms);
+
+    // State 1 or 2 means set or reset, 3 permanently set, 0 unknown and 4
+    // permanently reset
+    static constexpr std::string_view mode_report = "\e[?2026;";
+    size_t report = answer.find(mode_report);
+    if (report == std::string::npos
+        || report + mode_report.size() >= answer.size()) {
+        return false;
+    }
+    char state = answer[report + mode_report.size()];
+    // Terminals always synchronizing ignore the mode, which is harmless
+    return state == '1' || state == '2' || state == '3';
+}
+
+bool query_keyboard_enhancement(int timeout_ms)
+{
+    // Query the current keyboard enhancement flags, answered with
+    // "\e[?<flags>u" by the terminals supporting the protocol
+    static constexpr std::string_view flags_report = "\e[?";
+    std::string answer = query("\e[?u", timeout_ms);
+    for (size_t report = answer.find(flags_report);
+         report != std::string::npos;
+         report = answer.find(flags_report, report + 1)) {
+        size_t end = answer.find_first_not_of(
+            "0123456789",
+            report + flags_report.size());
+        if (end != std::string::npos && answer[end] == 'u') {
+            return true;
+        }
+    }
+    return false;
+}
+
+void push_keyboard_enhancement()
+{
+    // Only ask to disambiguate the escape codes, the other keys are still sent
+    // as usual
+    static constexpr const char code[] = "\e[>1u";
+    // Send code right away
+    print_n(code, sizeof(code) - 1);
+}
+
+void pop_keyboard_enhancement()
+{
+    static constexpr const char code[] = "\e[<u";
+    // Send code right away
+    print_n(code, sizeof(code) - 1);
+}
+
 void enter_main_screen_buffer()
 {
     static constexpr const char code[] = "\e[?1049l";
@@ -101,4 +256,18 @@ void enter_alternate_screen_buffer()
     print_n(code, sizeof(code) - 1);
 }
 
+void enable_bracketed_paste()
+{
+    static constexpr const char code[] = "\e[?2004h";
+    // Send code right away
+    print_n(code, sizeof(code) - 1);
+}
+
+void disable_bracketed_paste()
+{
+    static constexpr const char code[] = "\e[?2004l";
+    // Send code right away
+    print_n(code, sizeof(code) - 1);
+}
+
 } // namespace ted::term
@@ -5,6 +5,7 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <string_view>
 
 namespace ted::term {
 
@@ -33,18 +34,80 @@ enum class ClearMode : uint8_t {
 void clear(ClearMode mode);
 void clear();
 
+// Restrict scrolling to the rows [top, bottom), moving the cursor home
+void set_scroll_region(size_t top, size_t bottom);
+void reset_scroll_region();
+// Move the content of the scroll region up or down, the rows entering it
+// being blank
+void scroll_up(size_t rows);
+void scroll_down(size_t rows);
+
+void attribute_inverse();
+void attribute_reset();
+
+// Have the terminal show the output sent between these two calls at once
+void begin_synchronized_update();
+void end_synchronized_update();
+
+// Ask the terminal whether it supports synchronized updates, waiting for its
+// answer for at most `timeout_ms` milliseconds
+[[nodiscard]]
+bool query_synchronized_update(int timeout_ms);
+
+// Ask the terminal whether it supports the kitty keyboard protocol, waiting for
+// its answer for at most `timeout_ms` milliseconds
+[[nodiscard]]
+bool query_keyboard_enhancement(int timeout_ms);
+
+// Have the terminal send unambiguous sequences for the escape key and the keys
+// with modifiers, following the kitty keyboard protocol, until the previous
+// mode is restored
+void push_keyboard_enhancement();
+void pop_keyboard_enhancement();
+
 void enter_main_screen_buffer();
 void enter_alternate_screen_buffer();
 
+// Have the terminal enclose pasted text between "\e[200~" and "\e[201~", so
+// that it can be told apart from typed keys
+void enable_bracketed_paste();
+void disable_bracketed_paste();
+
 [[nodiscard, deprecated]]
 constexpr char key_ctrl(char key)
 {
     return key & 0x1f;
 }
 
+// Read the next input byte, return false if there is none yet. Input is read
+// from the terminal in blocks and buffered. The program exits through
+// os::exit_err() once the input is closed, as when the terminal is gone.
 [[nodiscard]]
 bool read_key(uint8_t& byte);
 
+// Same as read_key(), waiting at most `timeout_ms` milliseconds for input
+[[nodiscard]]
+bool read_key_timeout(uint8_t& byte, int timeout_ms);
+
+// Input bytes read from the terminal and not consumed, reading the available
+// input first if none is buffered. The view is invalidated by the next read.
+[[nodiscard]]
+std::string_view read_input();
+
+// Consume the first `count` bytes of the buffered input
+void consume_input(size_t count);
+
+// Wait at most `timeout_ms` milliseconds for input to be available, handling
+// the other events of the event loop meanwhile. Return false on timeout.
+// Returns at once if some input is buffered.
+[[nodiscard]]
+bool wait_input(int timeout_ms);
+
+// Same as wait_input(), also returning false once other events were handled,
+// and waiting forever if `timeout_ms` is negative
+[[nodiscard]]
+bool wait_input_or_event(int timeout_ms);
+
 void print_n(const void* buffer, size_t size);
 void print_cstr(const char* str);
 
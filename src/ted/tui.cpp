@@ -1,103 +1,148 @@
 #include <ted/editor.hpp>
+#include <ted/event_loop.hpp>
+#include <ted/grid.hpp>
 #include <ted/key.hpp>
+#include <ted/key_decoder.hpp>
 #include <ted/os.hpp>
 #include <ted/term.hpp>
 #include <ted/tui.hpp>
+#include <ted/utils.hpp>
 
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <chrono>
 #include <climits>
+#include <cstdint>
 #include <cstdio>
 #include <format>
+#include <optional>
+#include <string>
+#include <string_view>
 
 namespace ted::tui {
 
+// Time after which an escape byte not followed by the rest of a sequence is
+// taken as a press of the escape key. Sequences sent by the terminal arrive
+// at once, so their bytes are usually already buffered. With the kitty keyboard
+// protocol the escape key is sent as a sequence too, so this is never waited
+// for.
+static constexpr int escape_timeout_ms = 25;
+
+// Decode the sequence following an escape byte, taken as a press of the escape
+// key if the sequence is unknown or incomplete
 [[nodiscard]]
 static Key::Code read_escape_sequence()
 {
-    uint8_t seq[3];
-
-    if (!term::read_key(seq[0])) {
-        return Key::Code { '\e' };
-    }
-    if (!term::read_key(seq[1])) {
-        return Key::Code { '\e' };
-    }
-    if (seq[0] == '[') {
-        if (seq[1] >= '0' && seq[1] <= '9') {
-            if (!term::read_key(seq[2])) {
-                return Key::Code { '\e' };
-            }
-            if (seq[2] == '~') {
-                switch (seq[1]) {
-                case '1':
-                    return Key::Code::Home;
-                case '4':
-                    return Key::Code::End;
-                case '5':
-                    return Key::Code::PageUp;
-                case '6':
-                    return Key::Code::PageDown;
-                case '7':
-                    return Key::Code::Home;
-                case '8':
-                    return Key::Code::End;
-                default:
-                    break;
-                }
-            }
-        } else {
-            switch (seq[1]) {
-            case 'A':
-                return Key::Code::Up;
-            case 'B':
-                return Key::Code::Down;
-            case 'C':
-                return Key::Code::Right;
-            case 'D':
-                return Key::Code::Left;
-            case 'H':
-                return Key::Code::Home;
-            case 'F':
-                return Key::Code::End;
-            default:
-                break;
-            }
+    key_decoder::Decoder decoder;
+    key_decoder::Result result = key_decoder::decode(decoder, "\e");
+    while (result.status == key_decoder::Status::Incomplete) {
+        if (!term::wait_input(escape_timeout_ms)) {
+            return Key::Code::Escape;
         }
-    } else if (seq[0] == 'O') {
-        switch (seq[1]) {
-        case 'H':
-            return Key::Code::Home;
-        case 'F':
-            return Key::Code::End;
-        default:
-            break;
+        std::string_view input = term::read_input();
+        if (input.empty()) {
+            return Key::Code::Escape;
         }
+        result = key_decoder::decode(decoder, input);
+        term::consume_input(result.length);
     }
-    return Key::Code { '\e' };
+    if (result.status == key_decoder::Status::Invalid) {
+        return Key::Code::Escape;
+    }
+    return result.key;
 }
 
 [[nodiscard]]
 static Key::Code read_key()
 {
     uint8_t byte = 0;
-    while (!term::read_key(byte)) { }
+    // Nothing may be read yet when the read is interrupted, wait for input
+    // rather than trying again at once
+    while (!term::read_key(byte)) {
+        (void)term::wait_input_or_event(-1);
+    }
     if (byte == '\e') {
         return read_escape_sequence();
     }
     return Key::Code { byte };
 }
 
+// Time to wait for the rest of a paste whose end marker was not received yet
+static constexpr int paste_timeout_ms = 1000;
+
+// Read the text pasted after a paste start marker up to the end marker. The
+// text is taken from the input buffer a block at a time, not key by key.
+[[nodiscard]]
+static std::string read_pasted_text()
+{
+    static constexpr std::string_view end_marker = "\e[201~";
+    std::string text;
+    while (term::wait_input(paste_timeout_ms)) {
+        std::string_view input = term::read_input();
+        if (input.empty()) {
+            break;
+        }
+        size_t previous_size = text.size();
+        text.append(input);
+        // The end marker may be split across two blocks
+        size_t end = text.find(
+            end_marker,
+            previous_size - std::min(previous_size, end_marker.size() - 1));
+        if (end != std::string::npos) {
+            term::consume_input(end + end_marker.size() - previous_size);
+            text.resize(end);
+            return text;
+        }
+        term::consume_input(input.size());
+    }
+    // The terminal stopped sending the paste without ending it, or the wait
+    // was interrupted
+    return text;
+}
+
+// Terminals send the newlines of pasted text as carriage returns
+static void normalize_newlines(std::string& text)
+{
+    size_t out = 0;
+    for (size_t in = 0; in < text.size(); in++) {
+        if (text[in] == '\r') {
+            text[out++] = '\n';
+            if (in + 1 < text.size() && text[in + 1] == '\n') {
+                in++;
+            }
+        } else {
+            text[out++] = text[in];
+        }
+    }
+    text.resize(out);
+}
+
+static void paste()
+{
+    std::string text = read_pasted_text();
+    normalize_newlines(text);
+    editor::insert_text(text);
+}
+
+// Whether a key without handler inserts its character: the visible ASCII
+// characters, tabs and the bytes of the non-ASCII UTF-8 characters
+[[nodiscard]]
+static bool is_text_key(Key::Code keycode)
+{
+    return (Key::Code::Space <= keycode && keycode < Key::Code::Delete)
+        || keycode == Key::Code::Tab || (0x80 <= keycode && keycode <= 0xff);
+}
+
 static void process_key(Key::Code keycode)
 {
+    editor::state.message.clear();
     auto key_handler = editor::get_keymap(keycode);
     if (key_handler != nullptr) {
         // TODO handle userdata
         key_handler(nullptr);
-    } else {
-        // TODO if visible char only
-        editor::screen_buffer_append_char(keycode);
+    } else if (is_text_key(keycode)) {
+        editor::insert_char(static_cast<char>(keycode));
     }
 }
 
@@ -134,13 +179,71 @@ static void load_default_tui_keymap()
         }
     });
 
-    editor::set_keymap(Key::Code { '\r' }, [](void*) {
-        editor::screen_buffer_append("\r\n");
+    editor::set_keymap(Key::Code::Return, [](void*) {
+        editor::insert_newline();
+    });
+    // Terminals send either DEL or BS for the backspace key
+    editor::set_keymap(Key::Code::Delete, [](void*) {
+        editor::delete_char_before();
+    });
+    editor::set_keymap(Key::Code::CtrlH, [](void*) {
+        editor::delete_char_before();
+    });
+    editor::set_keymap(Key::Code::Backspace, [](void*) {
+        editor::delete_char_before();
+    });
+    editor::set_keymap(Key::Code::DeleteChar, [](void*) {
+        editor::delete_char();
+    });
+
+    editor::set_keymap(Key::Code::CtrlZ, [](void*) { editor::undo(); });
+    editor::set_keymap(Key::Code::CtrlY, [](void*) { editor::redo(); });
+
+    editor::set_keymap(Key::Code::CtrlN, [](void*) {
+        editor::view_next_file();
+    });
+    editor::set_keymap(Key::Code::CtrlP, [](void*) {
+        editor::view_previous_file();
+    });
+    editor::set_keymap(Key::Code::CtrlW, [](void*) {
+        editor::close_file(editor::state.viewed_handle);
+    });
+
+    editor::set_keymap(Key::Code::BracketedPaste, [](void*) { paste(); });
+
+    editor::set_keymap(Key::Code::CtrlS, [](void*) {
+        editor::save_file(editor::state.viewed_handle);
     });
 
     editor::set_keymap(Key::Code::CtrlQ, [](void*) { os::exit_ok(); });
 }
 
+// Rows at the bottom of the terminal not used to show the text
+static constexpr size_t status_bar_rows = 1;
+
+// Interval between two refreshes of the loading or saving progress
+static constexpr int progress_refresh_ms = 100;
+
+using Clock = std::chrono::steady_clock;
+
+// Time given to the terminal to answer the capability queries
+static constexpr int query_timeout_ms = 200;
+
+static grid::Renderer renderer;
+
+// Wakes the main loop up to show the loading or saving progress, armed while
+// loading or saving
+static event_loop::SourceId progress_timer;
+
+// Whether the terminal supports synchronized updates, avoiding tearing while a
+// frame is drawn
+static bool synchronized_update = false;
+
+static size_t text_rows(size_t rows)
+{
+    return rows > status_bar_rows ? rows - status_bar_rows : 1;
+}
+
 void handle_resize()
 {
     // Handle window resizing
@@ -152,6 +255,7 @@ void handle_resize()
     }
     size_t screen_size_rows = editor::get_screen_rows();
     size_t screen_size_cols = editor::get_screen_cols();
+    rows = text_rows(rows);
     if (rows != screen_size_rows || cols != screen_size_cols) {
         editor::set_screen_rows(rows);
         editor::set_screen_cols(cols);
@@ -164,14 +268,23 @@ void init()
 {
     size_t rows = 0;
     size_t cols = 0;
+    event_loop::init();
     term::init();
     if (!term::get_size(rows, cols)) {
         // TODO fallback to escape sequence computing
         os::exit_err("ted::term::get_size() failed");
     }
-    editor::set_screen_rows(rows);
+    editor::set_screen_rows(text_rows(rows));
     editor::set_screen_cols(cols);
+    synchronized_update = term::query_synchronized_update(query_timeout_ms);
+    if (editor::state.kitty_keyboard
+        && term::query_keyboard_enhancement(query_timeout_ms)) {
+        term::push_keyboard_enhancement();
+        // Restored before the terminal is
+        os::at_exit(os::Ring::_2, term::pop_keyboard_enhancement);
+    }
     load_default_tui_keymap();
+    progress_timer = event_loop::add_timer(nullptr, nullptr);
 }
 
 static constexpr std::string_view welcome_message[] {
@@ -182,6 +295,7 @@ static constexpr std::string_view welcome_message[] {
     "",
     "hit  CTRL+Q     to quit",
     "hit  CTRL+S     to save",
+    "hit  CTRL+W     to close",
     // TODO format keybinds depending on current config
 };
 
@@ -208,11 +322,11 @@ static bool should_draw_welcome_message(size_t current_row)
         return false;
     }
 
-    if (editor::state.viewed_file->lines.size() > 1) {
+    if (editor::has_line(*editor::state.viewed_file, 1)) {
         return false;
     }
 
-    if (editor::state.viewed_file->lines[0].length() > 2) {
+    if (editor::line_length(*editor::state.viewed_file, 0) > 0) {
         return false;
     }
 
@@ -221,7 +335,7 @@ static bool should_draw_welcome_message(size_t current_row)
     return start_line <= current_row && current_row < end_line;
 }
 
-static void draw_welcome_message(size_t welcome_message_line)
+static void draw_welcome_message(size_t row, size_t welcome_message_line)
 {
     if (welcome_message_line >= size(welcome_message)) {
         os::exit_err_format(
@@ -234,7 +348,7 @@ static void draw_welcome_message(size_t welcome_message_line)
         "{:^{}}",
         welcome_message[welcome_message_line],
         editor::get_screen_cols() - 1);
-    editor::screen_buffer_append(line.c_str());
+    grid::put(renderer.back, row, 1, line);
 }
 
 static void draw_lines()
@@ -245,33 +359,72 @@ static void draw_lines()
     if (file == nullptr) {
         os::exit_err("No viewed file, this should not happen");
     }
+    // Holds the visible part of lines split across several storage spans
+    static std::string scratch;
     for (size_t row = 0; row < editor::get_screen_rows(); row++) {
-        term::erase_line();
         size_t line_index = row + editor::state.viewport_offset.row;
-        if (line_index < file->lines.size()) {
-            ssize_t display_len = (ssize_t)file->lines[line_index].size()
-                - editor::state.viewport_offset.col;
-            display_len = std::clamp<ssize_t>(
-                display_len,
-                0,
-                editor::get_screen_cols());
-            const char* start_of_line
-                = &file->lines[line_index]
-                       .data()[editor::state.viewport_offset.col];
-            editor::screen_buffer_append_n(start_of_line, display_len);
+        if (editor::has_line(*file, line_index)) {
+            size_t first_col = editor::state.viewport_offset.col;
+            editor::LineColumn start
+                = editor::find_render_col(*file, line_index, first_col);
+            // Each character takes at least one column, so the visible part of
+            // the line is within as many characters as columns from its first
+            // character up to the end of the row
+            size_t chars = first_col + editor::get_screen_cols()
+                - start.render_col;
+            std::string_view text = editor::line_text(
+                *file,
+                line_index,
+                start.col,
+                chars * utils::max_char_length,
+                scratch);
+            grid::put_line(
+                renderer.back,
+                row,
+                text,
+                start.render_col,
+                first_col,
+                editor::state.tab_stop);
         } else {
-            editor::screen_buffer_append_char(eob_char);
+            grid::put(renderer.back, row, 0, std::string_view(&eob_char, 1));
             if (should_draw_welcome_message(row)) {
-                draw_welcome_message(welcome_message_line++);
+                draw_welcome_message(row, welcome_message_line++);
             }
         }
-        // Print last line without EOL
-        if (row < editor::get_screen_rows() - 1) {
-            editor::screen_buffer_append("\r\n");
-        }
     }
 }
 
+static void draw_status_bar()
+{
+    // Nothing depending on the cursor position is shown here, so that moving
+    // the cursor only needs to send the new position
+    const editor::File& file = *editor::state.viewed_file;
+    std::string status = file.path.empty() ? "[No Name]" : file.path;
+    if (unsigned progress = editor::load_progress(file); progress < 100) {
+        status += std::format(" - indexing {}%", progress);
+    }
+    if (unsigned progress = editor::save_progress(editor::state.viewed_handle);
+        progress < 100) {
+        status += std::format(" - saving {}%", progress);
+    }
+    if (!editor::state.message.empty()) {
+        status += " - " + editor::state.message;
+    }
+    size_t end_col = grid::put(
+        renderer.back,
+        editor::get_screen_rows(),
+        0,
+        status,
+        grid::Attribute::Inverse);
+    // Filled up to the end of the row, whatever the length of its characters
+    grid::put(
+        renderer.back,
+        editor::get_screen_rows(),
+        end_col,
+        std::string(editor::get_screen_cols() - end_col, ' '),
+        grid::Attribute::Inverse);
+}
+
 static void write_screen_buffer()
 {
     std::string& screen_buffer = editor::state.screen_buffer;
@@ -279,29 +432,145 @@ static void write_screen_buffer()
     screen_buffer.clear();
 }
 
+// Everything the content of a frame depends on, the frame being drawn again
+// only when it differs from the one of the previous frame
+struct FrameState {
+    editor::FileHandle file;
+    uint64_t revision = 0;
+    editor::Coord viewport_offset;
+    editor::ScreenSize screen_size;
+    unsigned load_progress = 0;
+    unsigned save_progress = 0;
+    std::string message;
+
+    bool operator==(const FrameState&) const = default;
+};
+
+static FrameState get_frame_state()
+{
+    const editor::File& file = *editor::state.viewed_file;
+    return FrameState {
+        .file = editor::state.viewed_handle,
+        .revision = file.revision,
+        .viewport_offset = editor::state.viewport_offset,
+        .screen_size = editor::state.screen_size,
+        .load_progress = editor::load_progress(file),
+        .save_progress = editor::save_progress(editor::state.viewed_handle),
+        .message = editor::state.message,
+    };
+}
+
+// Let the terminal scroll the text rows when the viewport only moved
+// vertically since the previous frame
+static void scroll_text_rows(
+    const FrameState& frame_state,
+    const std::optional<FrameState>& last_frame_state)
+{
+    if (!last_frame_state) {
+        return;
+    }
+    FrameState moved = *last_frame_state;
+    moved.viewport_offset.row = frame_state.viewport_offset.row;
+    if (moved != frame_state) {
+        return;
+    }
+    auto rows = static_cast<std::ptrdiff_t>(frame_state.viewport_offset.row)
+        - static_cast<std::ptrdiff_t>(last_frame_state->viewport_offset.row);
+    grid::scroll(renderer, 0, editor::get_screen_rows(), rows);
+}
+
 static void refresh_screen()
 {
+    static std::optional<FrameState> last_frame_state;
+    static std::optional<editor::Coord> last_cursor;
+
     editor::scroll();
 
-    term::cursor_hide();
-    term::cursor_home();
+    FrameState frame_state = get_frame_state();
+    bool frame_changed
+        = !renderer.front_valid || last_frame_state != frame_state;
+    editor::Coord cursor {
+        .row = editor::get_cursor_row() - editor::state.viewport_offset.row,
+        .col = editor::get_cursor_render_col()
+            - editor::state.viewport_offset.col,
+    };
+    if (!frame_changed && last_cursor == cursor) {
+        return;
+    }
 
-    draw_lines();
+    if (frame_changed) {
+        grid::begin_frame(
+            renderer,
+            editor::get_screen_rows() + status_bar_rows,
+            editor::get_screen_cols());
+        draw_lines();
+        draw_status_bar();
 
-    term::cursor_move(
-        editor::get_cursor_row() - editor::state.viewport_offset.row,
-        editor::get_cursor_col() - editor::state.viewport_offset.col);
-    term::cursor_show();
+        if (synchronized_update) {
+            term::begin_synchronized_update();
+        }
+        term::cursor_hide();
+        scroll_text_rows(frame_state, last_frame_state);
+        grid::present(renderer);
+        last_frame_state = frame_state;
+    }
+    term::cursor_move(cursor.row, cursor.col);
+    if (frame_changed) {
+        term::cursor_show();
+        if (synchronized_update) {
+            term::end_synchronized_update();
+        }
+    }
+    last_cursor = cursor;
 
     write_screen_buffer();
 }
 
+// Process the keys already received, then keep processing the keys received
+// until `frame_deadline`, so that a burst of keys produces a single frame
+static void process_pending_keys(Clock::time_point frame_deadline)
+{
+    while (true) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+            frame_deadline - Clock::now());
+        int timeout_ms = static_cast<int>(std::max<int64_t>(
+            remaining.count(),
+            0));
+        if (!term::wait_input(timeout_ms)) {
+            return;
+        }
+        process_key(read_key());
+    }
+}
+
 void start()
 {
+    using namespace std::chrono_literals;
+    Clock::duration frame_interval = 0s;
+    if (editor::state.max_fps > 0) {
+        frame_interval = std::chrono::duration_cast<Clock::duration>(1s)
+            / editor::state.max_fps;
+    }
+
+    bool progress_timer_armed = false;
     while (true) {
+        editor::update();
+        Clock::time_point frame_time = Clock::now();
         refresh_screen();
-        Key::Code keycode = read_key();
-        process_key(keycode);
+        if (bool in_progress = editor::is_loading() || editor::is_saving();
+            in_progress != progress_timer_armed) {
+            event_loop::set_timer(
+                progress_timer,
+                in_progress ? progress_refresh_ms : 0);
+            progress_timer_armed = in_progress;
+        }
+        // Draw a new frame after a resize, a file opened or saved in the
+        // background or a progress update even if no key is pressed
+        if (!term::wait_input_or_event(-1)) {
+            continue;
+        }
+        process_key(read_key());
+        process_pending_keys(frame_time + frame_interval);
     }
 }
 
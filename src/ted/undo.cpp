@@ -0,0 +1,326 @@
+#include <ted/undo.hpp>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace ted::undo {
+
+// Drop the undone deltas, replaced by the edit being recorded. The bytes of
+// each delta are copied after the ones of the previous deltas, so the bytes of
+// the dropped ones are the last of the journal.
+static void drop_undone(Journal& journal)
+{
+    if (journal.applied == journal.deltas.size()) {
+        return;
+    }
+    size_t first_span = journal.deltas[journal.applied].first_span;
+    size_t bytes_end = journal.bytes.size();
+    for (size_t index = first_span; index < journal.spans.size(); index++) {
+        const Span& span = journal.spans[index];
+        if (span.source == Source::Journal) {
+            bytes_end = std::min(bytes_end, span.start);
+        }
+    }
+    journal.deltas.resize(journal.applied);
+    journal.spans.resize(first_span);
+    journal.bytes.resize(bytes_end);
+}
+
+Span copy_text(Journal& journal, std::string_view text)
+{
+    drop_undone(journal);
+    size_t start = journal.bytes.size();
+    journal.bytes.append(text);
+    return Span { Source::Journal, start, text.size() };
+}
+
+std::string_view span_text(const Journal& journal, const Span& span)
+{
+    return std::string_view(journal.bytes).substr(span.start, span.length);
+}
+
+size_t spans_length(std::span<const Span> spans)
+{
+    size_t length = 0;
+    for (const Span& span : spans) {
+        length += span.length;
+    }
+    return length;
+}
+
+std::span<const Span> removed_spans(const Journal& journal, const Delta& delta)
+{
+    return std::span(journal.spans).subspan(
+        delta.first_span,
+        delta.removed_span_count);
+}
+
+std::span<const Span> inserted_spans(
+    const Journal& journal,
+    const Delta& delta)
+{
+    return std::span(journal.spans).subspan(
+        delta.first_span + delta.removed_span_count,
+        delta.inserted_span_count);
+}
+
+static bool follows(const Span& span, const Span& next)
+{
+    return span.source == next.source && span.start + span.length == next.start;
+}
+
+// Append spans after the last one of the journal, merging the contiguous ones,
+// the first one only if `merge_first`. Return the number of spans added.
+static uint32_t append_spans(
+    Journal& journal,
+    std::span<const Span> spans,
+    bool merge_first)
+{
+    uint32_t count = 0;
+    for (const Span& span : spans) {
+        if ((count > 0 || merge_first) && !journal.spans.empty()
+            && follows(journal.spans.back(), span)) {
+            journal.spans.back().length += span.length;
+        } else {
+            journal.spans.push_back(span);
+            count++;
+        }
+    }
+    return count;
+}
+
+// Insert spans before the first removed span of the last delta, merging the
+// contiguous ones
+static void prepend_removed_spans(
+    Journal& journal,
+    Delta& delta,
+    std::span<const Span> spans)
+{
+    auto position = journal.spans.begin()
+        + static_cast<std::ptrdiff_t>(delta.first_span);
+    for (auto span = spans.rbegin(); span != spans.rend(); span++) {
+        if (delta.removed_span_count > 0 && follows(*span, *position)) {
+            position->start = span->start;
+            position->length += span->length;
+        } else {
+            position = journal.spans.insert(position, *span);
+            delta.removed_span_count++;
+        }
+    }
+}
+
+// Remove the last `length` inserted bytes of the last delta, dropping the
+// delta if nothing is left of it
+static void shrink_inserted_spans(Journal& journal, size_t length)
+{
+    Delta& delta = journal.deltas.back();
+    while (length > 0) {
+        Span& span = journal.spans.back();
+        size_t shrunk = std::min(length, span.length);
+        if (span.source == Source::Journal
+            && span.start + span.length == journal.bytes.size()) {
+            journal.bytes.resize(journal.bytes.size() - shrunk);
+        }
+        span.length -= shrunk;
+        length -= shrunk;
+        if (span.length == 0) {
+            journal.spans.pop_back();
+            delta.inserted_span_count--;
+        }
+    }
+    if (delta.removed_span_count == 0 && delta.inserted_span_count == 0) {
+        journal.deltas.pop_back();
+    }
+}
+
+// Merge a typing edit in the last delta, return false if it cannot be
+static bool coalesce(
+    Journal& journal,
+    size_t offset,
+    std::span<const Span> removed,
+    std::span<const Span> inserted)
+{
+    Delta& last = journal.deltas.back();
+    size_t inserted_end
+        = last.offset + spans_length(inserted_spans(journal, last));
+    if (removed.empty() && last.removed_span_count == 0
+        && offset == inserted_end) {
+        last.inserted_span_count += append_spans(journal, inserted, true);
+        return true;
+    }
+    if (!inserted.empty()) {
+        return false;
+    }
+    size_t removed_length = spans_length(removed);
+    if (last.removed_span_count == 0
+        && offset + removed_length == inserted_end
+        && offset >= last.offset) {
+        // Erasing what was just typed, whose copy is not needed
+        for (const Span& span : removed) {
+            if (span.source == Source::Journal) {
+                journal.bytes.resize(span.start);
+                break;
+            }
+        }
+        shrink_inserted_spans(journal, removed_length);
+        return true;
+    }
+    if (last.inserted_span_count > 0) {
+        return false;
+    }
+    if (offset + removed_length == last.offset) {
+        // Deleting backward
+        prepend_removed_spans(journal, last, removed);
+        last.offset = offset;
+        return true;
+    }
+    if (offset == last.offset) {
+        // Deleting forward
+        last.removed_span_count += append_spans(journal, removed, true);
+        return true;
+    }
+    return false;
+}
+
+size_t memory_size(const Journal& journal)
+{
+    return (journal.deltas.size() * sizeof(Delta))
+        + (journal.spans.size() * sizeof(Span)) + journal.bytes.size();
+}
+
+// Drop the oldest groups so that the journal takes at most `limit` bytes.
+// A quarter more than needed is dropped, so that a full journal is not
+// compacted again on each edit.
+static void trim(Journal& journal, size_t limit)
+{
+    if (memory_size(journal) <= limit) {
+        return;
+    }
+    size_t target = limit - (limit / 4);
+    // Find the first group from which the groups fit, walking them backward
+    size_t first_kept = journal.deltas.size();
+    size_t kept_bytes_start = journal.bytes.size();
+    size_t bytes_start = journal.bytes.size();
+    for (size_t index = journal.deltas.size(); index-- > 0;) {
+        const Delta& delta = journal.deltas[index];
+        size_t spans_end = delta.first_span + delta.removed_span_count
+            + delta.inserted_span_count;
+        for (size_t span_index = delta.first_span; span_index < spans_end;
+             span_index++) {
+            const Span& span = journal.spans[span_index];
+            if (span.source == Source::Journal) {
+                bytes_start = std::min(bytes_start, span.start);
+            }
+        }
+        if (!delta.group_start) {
+            continue;
+        }
+        size_t size = ((journal.deltas.size() - index) * sizeof(Delta))
+            + ((journal.spans.size() - delta.first_span) * sizeof(Span))
+            + (journal.bytes.size() - bytes_start);
+        if (size > target) {
+            break;
+        }
+        first_kept = index;
+        kept_bytes_start = bytes_start;
+    }
+
+    size_t first_span = first_kept < journal.deltas.size()
+        ? journal.deltas[first_kept].first_span
+        : journal.spans.size();
+    journal.deltas.erase(
+        journal.deltas.begin(),
+        journal.deltas.begin() + static_cast<std::ptrdiff_t>(first_kept));
+    journal.spans.erase(
+        journal.spans.begin(),
+        journal.spans.begin() + static_cast<std::ptrdiff_t>(first_span));
+    journal.bytes.erase(0, kept_bytes_start);
+    for (Delta& delta : journal.deltas) {
+        delta.first_span -= first_span;
+    }
+    for (Span& span : journal.spans) {
+        if (span.source == Source::Journal) {
+            span.start -= kept_bytes_start;
+        }
+    }
+    journal.applied = journal.deltas.size();
+}
+
+void record(
+    Journal& journal,
+    size_t offset,
+    std::span<const Span> removed,
+    std::span<const Span> inserted,
+    bool typing,
+    size_t limit)
+{
+    drop_undone(journal);
+    bool joined = false;
+    if (typing && !journal.sealed && !journal.deltas.empty()) {
+        if (coalesce(journal, offset, removed, inserted)) {
+            journal.applied = journal.deltas.size();
+            trim(journal, limit);
+            return;
+        }
+        // Typing elsewhere than in the last group starts a new one
+        const Delta& last = journal.deltas.back();
+        size_t inserted_end
+            = last.offset + spans_length(inserted_spans(journal, last));
+        joined = offset <= inserted_end
+            && offset + spans_length(removed) >= last.offset;
+    }
+    Delta delta {
+        .offset = offset,
+        .first_span = journal.spans.size(),
+        .removed_span_count = append_spans(journal, removed, false),
+        .inserted_span_count = 0,
+        .group_start = !joined,
+    };
+    delta.inserted_span_count = append_spans(journal, inserted, false);
+    journal.deltas.push_back(delta);
+    journal.applied = journal.deltas.size();
+    journal.sealed = !typing;
+    trim(journal, limit);
+}
+
+void clear(Journal& journal)
+{
+    journal = Journal {};
+}
+
+void seal(Journal& journal)
+{
+    journal.sealed = true;
+}
+
+std::span<const Delta> undo(Journal& journal)
+{
+    size_t end = journal.applied;
+    if (end == 0) {
+        return {};
+    }
+    size_t first = end - 1;
+    while (first > 0 && !journal.deltas[first].group_start) {
+        first--;
+    }
+    journal.applied = first;
+    journal.sealed = true;
+    return std::span(journal.deltas).subspan(first, end - first);
+}
+
+std::span<const Delta> redo(Journal& journal)
+{
+    size_t first = journal.applied;
+    if (first == journal.deltas.size()) {
+        return {};
+    }
+    size_t end = first + 1;
+    while (end < journal.deltas.size() && !journal.deltas[end].group_start) {
+        end++;
+    }
+    journal.applied = end;
+    journal.sealed = true;
+    return std::span(journal.deltas).subspan(first, end - first);
+}
+
+} // namespace ted::undo
@@ -0,0 +1,108 @@
+#ifndef TED_UNDO_HPP_
+#define TED_UNDO_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ted::undo {
+
+// Where the bytes of a span of text recorded in the journal are kept
+enum class Source : uint8_t {
+    // Copied in the journal itself
+    Journal,
+    // In the original or add buffer of a piece table, which never change
+    Original,
+    Add,
+};
+
+struct Span {
+    Source source;
+    size_t start;
+    size_t length;
+};
+
+// An edit replacing the text at `offset` with another one, both described by
+// consecutive spans in Journal::spans: the removed ones first, then the
+// inserted ones
+struct Delta {
+    size_t offset;
+    size_t first_span;
+    uint32_t removed_span_count;
+    uint32_t inserted_span_count;
+    // Whether the delta is the first of a group, undone and redone at once
+    bool group_start;
+};
+
+// Log of the edits of a file, appended to by each edit. The deltas past
+// `applied` were undone and are dropped by the next edit.
+// Typing is coalesced in the last delta while it stays contiguous: inserting
+// extends its inserted spans, erasing what was just typed shrinks them, and
+// deleting characters before or after a removal extends its removed spans.
+// With the piece table, spans reference the buffers of the table and typing
+// costs no journal memory at all; the text of other storages is copied.
+struct Journal {
+    std::vector<Delta> deltas;
+    std::vector<Span> spans;
+    std::string bytes;
+    size_t applied = 0;
+    // Whether the next edit starts a new group even if it could be coalesced
+    bool sealed = false;
+};
+
+// Copy text in the journal, for recording it afterwards
+[[nodiscard]]
+Span copy_text(Journal& journal, std::string_view text);
+
+[[nodiscard]]
+std::string_view span_text(const Journal& journal, const Span& span);
+
+[[nodiscard]]
+size_t spans_length(std::span<const Span> spans);
+
+// Record an edit at `offset`, dropping the undone deltas. Typing edits are
+// coalesced with the previous one when possible. Then drop the oldest groups
+// until the journal takes at most `limit` bytes, spans referencing the piece
+// table buffers not being counted.
+void record(
+    Journal& journal,
+    size_t offset,
+    std::span<const Span> removed,
+    std::span<const Span> inserted,
+    bool typing,
+    size_t limit);
+
+// Drop all the deltas, for edits which cannot be recorded
+void clear(Journal& journal);
+
+// Start a new group with the next edit
+void seal(Journal& journal);
+
+// Mark the last applied group as undone and return its deltas, to be reverted
+// from the last one to the first one, or nothing if there is none
+[[nodiscard]]
+std::span<const Delta> undo(Journal& journal);
+
+// Mark the next undone group as applied and return its deltas, to be applied
+// from the first one to the last one, or nothing if there is none
+[[nodiscard]]
+std::span<const Delta> redo(Journal& journal);
+
+[[nodiscard]]
+std::span<const Span> removed_spans(const Journal& journal, const Delta& delta);
+
+[[nodiscard]]
+std::span<const Span> inserted_spans(
+    const Journal& journal,
+    const Delta& delta);
+
+// Bytes taken by the journal, as counted for its limit
+[[nodiscard]]
+size_t memory_size(const Journal& journal);
+
+} // namespace ted::undo
+
+#endif // TED_UNDO_HPP_
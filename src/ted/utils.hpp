@@ -1,6 +1,7 @@
 #ifndef TED_UTILS_HPP_
 #define TED_UTILS_HPP_
 
+#include <cstddef>
 #include <format>
 #include <source_location>
 #include <string_view>
@@ -10,6 +11,18 @@
 
 namespace ted::utils {
 
+// Bytes of the longest UTF-8 character
+inline constexpr size_t max_char_length = 4;
+
+// Whether a byte continues a UTF-8 character rather than starting one. Text is
+// shown one character per column, a character being made of a byte starting
+// it and all the continuation bytes following it.
+[[nodiscard]]
+constexpr bool is_continuation_byte(char c)
+{
+    return (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+}
+
 // Wrap a std::format_string and a default constructed std::source_location to
 // get source location info for APIs using <format>
 struct Fmt : public std::string_view {